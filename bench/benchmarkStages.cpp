@@ -0,0 +1,327 @@
+// Per-stage benchmark of the generator for every element type: corner
+// generation (generateNodes), midside insertion (addQuadraticNodes /
+// random_disturb_num), the Metric.txt writer and the Nastran deck writer.
+// Each stage runs single-threaded over N elements in reused batches, so
+// sizes up to 1e8 need no more memory than 1e5. Reports ns/element,
+// heap allocations/element and MB/s (coordinates produced or bytes written),
+// and with --json FILE the same numbers as JSON for regression tracking.
+//
+//   g++ -std=c++17 -O3 -fno-math-errno -pthread -Isrc bench/benchmarkStages.cpp
+//       src/elementGenerator.cpp src/elementMetrics.cpp src/instrumentation.cpp
+//       src/instrumentedAllocator.cpp -o benchmarkStages
+//
+// With -DELEMENT_INSTRUMENTATION the allocations are read from the
+// instrumentation counter instead of counted here.
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "elementBatch.h"
+#include "elementGenerator.h"
+#include "elementWriters.h"
+#include "instrumentation.h"
+
+#ifdef ELEMENT_INSTRUMENTATION
+
+// instrumentedAllocator.cpp already replaces operator new and counts
+static std::uint64_t allocationCount()
+{
+    return instrumentationTotal(InstrumentCounter::Allocations);
+}
+
+#else
+
+// Every heap allocation of the process goes through here and is counted
+static std::atomic<std::uint64_t> allocations{ 0 };
+
+static std::uint64_t allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    if (void* p = std::malloc(size > 0 ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+#endif
+
+namespace
+{
+
+const std::size_t BatchElements = 65536;
+
+struct StageResult
+{
+    std::string stage;
+    ElementType type;
+    std::uint64_t size;         // elements per repetition
+    std::uint64_t elements;     // elements over all repetitions
+    double seconds;
+    std::uint64_t allocations;
+    std::uint64_t bytes;        // coordinates produced or bytes written
+};
+
+// Run body (one pass over size elements, returning the bytes it produced)
+// until at least minSeconds have passed
+StageResult measure(const std::string& stage, ElementType type, std::uint64_t size, double minSeconds,
+                    const std::function<std::uint64_t()>& body)
+{
+    StageResult result{ stage, type, size, 0, 0.0, 0, 0 };
+    std::uint64_t allocationsBefore = allocationCount();
+    auto start = std::chrono::steady_clock::now();
+    do {
+        result.bytes += body();
+        result.elements += size;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (result.seconds < minSeconds);
+    result.allocations = allocationCount() - allocationsBefore;
+    return result;
+}
+
+// Batch of min(size, BatchElements) complete elements, and the tail that
+// makes the last partial batch of a pass over size elements
+void prepareBatches(ElementType type, std::uint64_t size, ElementBatch& full, ElementBatch& tail)
+{
+    ThreadPool serial(1);
+    GenerationOptions options;
+    options.seed = 1;
+    std::size_t fullSize = static_cast<std::size_t>(size < BatchElements ? size : BatchElements);
+    full = generateElementRange(type, 1000, fullSize, options, serial);
+    tail = ElementBatch(type, static_cast<std::size_t>(size % fullSize));
+    for (std::size_t i = 0; i < tail.size(); ++i) {
+        tail.copyElement(i, full, i);
+    }
+}
+
+template <typename Traits>
+void benchmarkType(std::uint64_t size, std::uint64_t maxWrite, double minSeconds, const std::string& outDir,
+                   std::vector<StageResult>& results)
+{
+    const ElementType type = Traits::Type;
+    ElementBatch full(type);
+    ElementBatch tail(type);
+    prepareBatches(type, size, full, tail);
+    const std::size_t batchSize = full.size();
+
+    results.push_back(measure("generateNodes", type, size, minSeconds, [&]() {
+        for (std::uint64_t e = 0; e < size; ++e) {
+            PhiloxRng rng(7, e);
+            generateNodes<Traits>(full, static_cast<std::size_t>(e % batchSize), 0.0, 10.0, rng);
+        }
+        return size * Traits::Corners * 3 * sizeof(double);
+    }));
+
+    if (Traits::Midside > 0) {
+        results.push_back(measure("addQuadraticNodes", type, size, minSeconds, [&]() {
+            PerturbationEngine engine(7);
+            for (std::uint64_t e = 0; e < size; ++e) {
+                engine.seek(e);
+                addQuadraticNodes<Traits>(full, static_cast<std::size_t>(e % batchSize), engine);
+            }
+            return size * Traits::Midside * 3 * sizeof(double);
+        }));
+    }
+
+    if (size > maxWrite) {
+        return;
+    }
+    const std::string metricPath = outDir + "Metric.txt";
+    results.push_back(measure("metricWriter", type, size, minSeconds, [&]() {
+        MetricWriter metric;
+        if (!metric.open(metricPath)) {
+            throw std::runtime_error("cannot open " + metricPath);
+        }
+        for (std::uint64_t first = 0; first + batchSize <= size; first += batchSize) {
+            metric.write(full);
+        }
+        metric.write(tail);
+        std::uint64_t bytes = metric.bytesWritten();
+        metric.close();
+        return bytes;
+    }));
+    std::remove(metricPath.c_str());
+
+    results.push_back(measure("nastranWriter", type, size, minSeconds, [&]() {
+        NastranWriter nastran;
+        if (!nastran.open(outDir, NastranWriter::Layout::Deck)) {
+            throw std::runtime_error("cannot open " + outDir + "RandomElements.nas");
+        }
+        std::uint64_t first = 0;
+        for (; first + batchSize <= size; first += batchSize) {
+            nastran.write(full, first);
+        }
+        nastran.write(tail, first);
+        nastran.close();
+        return nastran.bytesWritten();
+    }));
+    std::remove((outDir + "RandomElements.nas").c_str());
+}
+
+bool parseList(const std::string& value, std::vector<std::string>& items)
+{
+    items.clear();
+    std::size_t begin = 0;
+    while (begin <= value.size()) {
+        std::size_t comma = value.find(',', begin);
+        items.push_back(value.substr(begin, comma == std::string::npos ? std::string::npos : comma - begin));
+        if (comma == std::string::npos) {
+            break;
+        }
+        begin = comma + 1;
+    }
+    return !items.empty();
+}
+
+void writeJson(std::FILE* out, const std::vector<StageResult>& results)
+{
+    std::fprintf(out, "{\n  \"benchmark\": \"stages\",\n  \"results\": [\n");
+    for (std::size_t r = 0; r < results.size(); ++r) {
+        const StageResult& s = results[r];
+        double elements = static_cast<double>(s.elements);
+        std::fprintf(out,
+                     "    {\"stage\": \"%s\", \"type\": \"%s\", \"size\": %llu, \"elements\": %llu, \"seconds\": %.6g, "
+                     "\"nsPerElement\": %.6g, \"allocationsPerElement\": %.6g, \"megabytesPerSecond\": %.6g}%s\n",
+                     s.stage.c_str(), elementTypeName(s.type), static_cast<unsigned long long>(s.size),
+                     static_cast<unsigned long long>(s.elements), s.seconds, 1e9 * s.seconds / elements,
+                     static_cast<double>(s.allocations) / elements, static_cast<double>(s.bytes) / s.seconds / 1e6,
+                     r + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+void printUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --sizes LIST      comma-separated element counts (default 1e3,1e4,1e5,1e6,1e7,1e8)\n"
+              << "  --types LIST      comma-separated element types (default all)\n"
+              << "  --max-write N     largest count run through the writers (default 1e6)\n"
+              << "  --min-time S      repeat each measurement for at least S seconds (default 0.2)\n"
+              << "  --out-dir DIR     directory for the temporary writer output, with trailing separator\n"
+              << "  --json FILE       also write the results as JSON" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::uint64_t> sizes = { 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+    std::vector<ElementType> types;
+    std::uint64_t maxWrite = 1000000;
+    double minSeconds = 0.2;
+    std::string outDir;
+    std::string jsonPath;
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (a + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string value = argv[++a];
+        std::vector<std::string> items;
+        try {
+            if (arg == "--sizes" && parseList(value, items)) {
+                sizes.clear();
+                for (const std::string& item : items) {
+                    sizes.push_back(static_cast<std::uint64_t>(std::stod(item)));
+                }
+            }
+            else if (arg == "--types" && parseList(value, items)) {
+                for (const std::string& item : items) {
+                    ElementType type;
+                    if (!parseElementType(item, type)) {
+                        std::cerr << "Unknown element type " << item << std::endl;
+                        return 1;
+                    }
+                    types.push_back(type);
+                }
+            }
+            else if (arg == "--max-write") {
+                maxWrite = static_cast<std::uint64_t>(std::stod(value));
+            }
+            else if (arg == "--min-time") {
+                minSeconds = std::stod(value);
+            }
+            else if (arg == "--out-dir") {
+                outDir = value;
+            }
+            else if (arg == "--json") {
+                jsonPath = value;
+            }
+            else {
+                std::cerr << "Unknown option " << arg << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Invalid value " << value << " for " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (types.empty()) {
+        for (int t = 0; t < NumElementTypes; ++t) {
+            types.push_back(static_cast<ElementType>(t));
+        }
+    }
+
+    std::vector<StageResult> results;
+    std::printf("%-18s %-18s %10s %12s %12s %10s\n", "stage", "type", "size", "ns/element", "allocs/elm", "MB/s");
+    try {
+        for (ElementType type : types) {
+            for (std::uint64_t size : sizes) {
+                if (size == 0) {
+                    continue;
+                }
+                std::size_t before = results.size();
+                withElementTraits(type, [&](auto traits) {
+                    benchmarkType<decltype(traits)>(size, maxWrite, minSeconds, outDir, results);
+                });
+                for (std::size_t r = before; r < results.size(); ++r) {
+                    const StageResult& s = results[r];
+                    double elements = static_cast<double>(s.elements);
+                    std::printf("%-18s %-18s %10llu %12.2f %12.4f %10.1f\n", s.stage.c_str(), elementTypeName(s.type),
+                                static_cast<unsigned long long>(s.size), 1e9 * s.seconds / elements,
+                                static_cast<double>(s.allocations) / elements, static_cast<double>(s.bytes) / s.seconds / 1e6);
+                }
+                std::fflush(stdout);
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (!jsonPath.empty()) {
+        std::FILE* json = std::fopen(jsonPath.c_str(), "w");
+        if (json == nullptr) {
+            std::cerr << "Failed to open " << jsonPath << std::endl;
+            return 1;
+        }
+        writeJson(json, results);
+        std::fclose(json);
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+// Flat coordinate storage of elements shared by the generator, the writers
+// and the quality metrics.
+#ifndef ELEMENT_BATCH_H
+#define ELEMENT_BATCH_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "elementTopology.h"
+
+// Elements of a single type stored as one contiguous block of coordinates.
+// The block holds all x, then all y, then all z; node j of element e sits at
+// index e * nodesPerElement + j of each of the three arrays. The block is
+// either owned by the batch or, for a view, memory of the caller.
+class ElementBatch
+{
+public:
+    explicit ElementBatch(ElementType elmType, std::size_t numElements = 0)
+        : type(elmType), nodesPerElement(::nodesPerElement(elmType)), count(numElements),
+          coords(3 * numElements * static_cast<std::size_t>(nodesPerElement), 0.0), data(coords.data())
+    {
+    }
+
+    // View of numElements elements in caller-owned storage of
+    // 3 * numElements * nodesPerElement doubles, laid out as above. Nothing
+    // is allocated or freed; the storage must outlive the view.
+    ElementBatch(ElementType elmType, double* storage, std::size_t numElements)
+        : type(elmType), nodesPerElement(::nodesPerElement(elmType)), count(numElements),
+          view(true), viewCapacity(3 * numElements * static_cast<std::size_t>(nodesPerElement)), data(storage)
+    {
+    }
+
+    // Copies of a view share its storage, copies of an owning batch own a copy
+    ElementBatch(const ElementBatch& other)
+        : type(other.type), nodesPerElement(other.nodesPerElement), count(other.count), coords(other.coords),
+          view(other.view), viewCapacity(other.viewCapacity), data(other.view ? other.data : coords.data())
+    {
+    }
+
+    ElementBatch(ElementBatch&& other) noexcept
+        : type(other.type), nodesPerElement(other.nodesPerElement), count(other.count), coords(std::move(other.coords)),
+          view(other.view), viewCapacity(other.viewCapacity), data(other.view ? other.data : coords.data())
+    {
+    }
+
+    ElementBatch& operator=(const ElementBatch& other)
+    {
+        if (this != &other)
+        {
+            ElementBatch copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    ElementBatch& operator=(ElementBatch&& other) noexcept
+    {
+        type = other.type;
+        nodesPerElement = other.nodesPerElement;
+        count = other.count;
+        coords = std::move(other.coords);
+        view = other.view;
+        viewCapacity = other.viewCapacity;
+        data = other.view ? other.data : coords.data();
+        return *this;
+    }
+
+    std::size_t size() const { return count; }
+
+    bool isView() const { return view; }
+
+    // Change the number of elements; coordinates are left unspecified. The
+    // block is only reallocated when it grows beyond its capacity; a view
+    // cannot grow beyond its storage (std::bad_alloc).
+    void resize(std::size_t numElements)
+    {
+        std::size_t values = 3 * numElements * static_cast<std::size_t>(nodesPerElement);
+        if (view)
+        {
+            if (values > viewCapacity)
+            {
+                throw std::bad_alloc();
+            }
+        }
+        else
+        {
+            coords.resize(values);
+            data = coords.data();
+        }
+        count = numElements;
+    }
+
+    std::size_t numNodes() const { return count * static_cast<std::size_t>(nodesPerElement); }
+
+    double* xData() { return data; }
+    double* yData() { return data + numNodes(); }
+    double* zData() { return data + 2 * numNodes(); }
+    const double* xData() const { return data; }
+    const double* yData() const { return data + numNodes(); }
+    const double* zData() const { return data + 2 * numNodes(); }
+
+    std::size_t nodeIndex(std::size_t elm, int node) const
+    {
+        return elm * static_cast<std::size_t>(nodesPerElement) + static_cast<std::size_t>(node);
+    }
+
+    double& x(std::size_t elm, int node) { return xData()[nodeIndex(elm, node)]; }
+    double& y(std::size_t elm, int node) { return yData()[nodeIndex(elm, node)]; }
+    double& z(std::size_t elm, int node) { return zData()[nodeIndex(elm, node)]; }
+    double x(std::size_t elm, int node) const { return xData()[nodeIndex(elm, node)]; }
+    double y(std::size_t elm, int node) const { return yData()[nodeIndex(elm, node)]; }
+    double z(std::size_t elm, int node) const { return zData()[nodeIndex(elm, node)]; }
+
+    void setNode(std::size_t elm, int node, double xc, double yc, double zc)
+    {
+        x(elm, node) = xc;
+        y(elm, node) = yc;
+        z(elm, node) = zc;
+    }
+
+    // Copy all nodes of element srcElm of src into element elm of this batch
+    void copyElement(std::size_t elm, const ElementBatch& src, std::size_t srcElm)
+    {
+        for (int j = 0; j < nodesPerElement; ++j)
+        {
+            setNode(elm, j, src.x(srcElm, j), src.y(srcElm, j), src.z(srcElm, j));
+        }
+    }
+
+    ElementType type;
+    int nodesPerElement;
+
+private:
+    std::size_t count;
+    std::vector<double> coords;
+    bool view = false;            // data is caller storage rather than coords
+    std::size_t viewCapacity = 0; // doubles of caller storage
+    double* data;
+};
+
+#endif
@@ -0,0 +1,181 @@
+// Binary element file written by generateRandomElements (--output bin) and a
+// zero-copy reader for it. Header-only, no dependency on the generator.
+//
+// Layout, host byte order (little-endian on every supported target):
+//   offset 0   ElementFileHeader (64 bytes)
+//   offset 64  count elements, each nodesPerElement nodes of x, y, z doubles
+// Element i therefore starts at byte 64 + i * nodesPerElement * 24, and
+// every coordinate is 8-byte aligned in the mapping.
+#ifndef ELEMENT_BINARY_READER_H
+#define ELEMENT_BINARY_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct ElementFileHeader
+{
+    char magic[4];                  // "GREB"
+    std::uint32_t version;          // ElementFileVersion
+    std::uint32_t elementType;      // ElementType value, LINEAR_TRIANGLE = 0 in declaration order
+    std::uint32_t nodesPerElement;
+    std::uint64_t count;            // number of elements in the file
+    std::uint64_t seed;             // run seed
+    std::uint64_t firstIndex;       // run index of the first element
+    double minCoord;
+    double maxCoord;
+    std::uint64_t reserved;
+};
+
+static_assert(sizeof(ElementFileHeader) == 64, "ElementFileHeader must stay 64 bytes");
+
+constexpr std::uint32_t ElementFileVersion = 1;
+constexpr char ElementFileMagic[4] = { 'G', 'R', 'E', 'B' };
+
+// Maps an element file read-only and exposes its coordinates in place
+class ElementFileReader
+{
+public:
+    ElementFileReader() = default;
+    ~ElementFileReader() { close(); }
+
+    ElementFileReader(const ElementFileReader&) = delete;
+    ElementFileReader& operator=(const ElementFileReader&) = delete;
+
+    // false if the file cannot be mapped or is not a complete element file
+    bool open(const char* path)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(ElementFileHeader)))
+        {
+            close();
+            return false;
+        }
+        mappedBytes = static_cast<std::size_t>(fileSize.QuadPart);
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr)
+        {
+            close();
+            return false;
+        }
+        data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (data == nullptr)
+        {
+            close();
+            return false;
+        }
+#else
+        fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(ElementFileHeader)))
+        {
+            close();
+            return false;
+        }
+        mappedBytes = static_cast<std::size_t>(st.st_size);
+        void* view = mmap(nullptr, mappedBytes, PROT_READ, MAP_SHARED, fd, 0);
+        if (view == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        data = static_cast<const unsigned char*>(view);
+#endif
+        const ElementFileHeader& h = header();
+        std::uint64_t elementBytes = static_cast<std::uint64_t>(h.nodesPerElement) * 3 * sizeof(double);
+        if (std::memcmp(h.magic, ElementFileMagic, 4) != 0 || h.version != ElementFileVersion ||
+            h.nodesPerElement == 0 ||
+            h.count > (mappedBytes - sizeof(ElementFileHeader)) / elementBytes)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (data != nullptr)
+        {
+            UnmapViewOfFile(data);
+        }
+        if (mapping != nullptr)
+        {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file);
+        }
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data != nullptr)
+        {
+            munmap(const_cast<unsigned char*>(data), mappedBytes);
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        fd = -1;
+#endif
+        data = nullptr;
+        mappedBytes = 0;
+    }
+
+    bool isOpen() const { return data != nullptr; }
+
+    const ElementFileHeader& header() const { return *reinterpret_cast<const ElementFileHeader*>(data); }
+    std::uint64_t size() const { return header().count; }
+    std::uint32_t nodesPerElement() const { return header().nodesPerElement; }
+
+    // nodesPerElement() * 3 coordinates of element i: x0, y0, z0, x1, ...
+    const double* element(std::uint64_t i) const
+    {
+        return reinterpret_cast<const double*>(data + sizeof(ElementFileHeader)) +
+               i * static_cast<std::uint64_t>(nodesPerElement()) * 3;
+    }
+
+    // x, y, z of node j of element i
+    const double* node(std::uint64_t i, std::uint32_t j) const { return element(i) + 3 * static_cast<std::uint64_t>(j); }
+
+private:
+    const unsigned char* data = nullptr;
+    std::size_t mappedBytes = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+#endif
@@ -0,0 +1,534 @@
+#include "elementGenerator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <new>
+
+#include "elementMetrics.h"
+#include "instrumentation.h"
+
+ElementBatch getStandardElement(ElementType type, double minCoord, double maxCoord) {
+    double midCoord = 0.5 * (minCoord + maxCoord);
+    double tenth = minCoord + 0.1 * (maxCoord - minCoord);
+    switch (type) {
+        case ElementType::LINEAR_TRIANGLE: {
+            ElementBatch elements(type, 2);
+            // ET
+            elements.setNode(0, 0, minCoord, minCoord, minCoord);
+            elements.setNode(0, 1, maxCoord, minCoord, maxCoord);
+            elements.setNode(0, 2, minCoord, maxCoord, maxCoord);
+            // RT
+            elements.setNode(1, 0, minCoord, minCoord, minCoord);
+            elements.setNode(1, 1, maxCoord, minCoord, minCoord);
+            elements.setNode(1, 2, minCoord, maxCoord, maxCoord);
+            return elements;
+        }
+        case ElementType::LINEAR_QUAD: {
+            ElementBatch elements(type, 3);
+            // square
+            elements.setNode(0, 0, minCoord, minCoord, minCoord);
+            elements.setNode(0, 1, maxCoord, minCoord, minCoord);
+            elements.setNode(0, 2, maxCoord, minCoord, maxCoord);
+            elements.setNode(0, 3, minCoord, minCoord, maxCoord);
+            // 10:1 rectangle
+            elements.setNode(1, 0, minCoord, minCoord, minCoord);
+            elements.setNode(1, 1, maxCoord, minCoord, minCoord);
+            elements.setNode(1, 2, maxCoord, minCoord, tenth);
+            elements.setNode(1, 3, minCoord, minCoord, tenth);
+            // tri-rectangle
+            elements.setNode(2, 0, minCoord, minCoord, minCoord);
+            elements.setNode(2, 1, maxCoord, minCoord, minCoord);
+            elements.setNode(2, 2, midCoord, midCoord, midCoord);
+            elements.setNode(2, 3, minCoord, maxCoord, maxCoord);
+            return elements;
+        }
+        case ElementType::LINEAR_TETRA: {
+            ElementBatch elements(type, 2);
+            // regular tetra
+            elements.setNode(0, 0, minCoord, minCoord, minCoord);
+            elements.setNode(0, 1, maxCoord, minCoord, maxCoord);
+            elements.setNode(0, 2, maxCoord, maxCoord, minCoord);
+            elements.setNode(0, 3, minCoord, maxCoord, maxCoord);
+            // right angle tetra
+            elements.setNode(1, 0, minCoord, minCoord, minCoord);
+            elements.setNode(1, 1, maxCoord, minCoord, minCoord);
+            elements.setNode(1, 2, minCoord, maxCoord, minCoord);
+            elements.setNode(1, 3, minCoord, minCoord, maxCoord);
+            return elements;
+        }
+        case ElementType::LINEAR_HEXA: {
+            ElementBatch elements(type, 2);
+            // Cube
+            elements.setNode(0, 0, minCoord, minCoord, minCoord);
+            elements.setNode(0, 1, maxCoord, minCoord, minCoord);
+            elements.setNode(0, 2, maxCoord, maxCoord, minCoord);
+            elements.setNode(0, 3, minCoord, maxCoord, minCoord);
+            elements.setNode(0, 4, minCoord, minCoord, maxCoord);
+            elements.setNode(0, 5, maxCoord, minCoord, maxCoord);
+            elements.setNode(0, 6, maxCoord, maxCoord, maxCoord);
+            elements.setNode(0, 7, minCoord, maxCoord, maxCoord);
+            // 10:10:1 Cube
+            elements.setNode(1, 0, minCoord, minCoord, minCoord);
+            elements.setNode(1, 1, maxCoord, minCoord, minCoord);
+            elements.setNode(1, 2, maxCoord, maxCoord, minCoord);
+            elements.setNode(1, 3, minCoord, maxCoord, minCoord);
+            elements.setNode(1, 4, minCoord, minCoord, tenth);
+            elements.setNode(1, 5, maxCoord, minCoord, tenth);
+            elements.setNode(1, 6, maxCoord, maxCoord, tenth);
+            elements.setNode(1, 7, minCoord, maxCoord, tenth);
+            return elements;
+        }
+        case ElementType::LINEAR_PYRAMID: {
+            ElementBatch elements(type, 2);
+            //
+            elements.setNode(0, 0, minCoord, minCoord, minCoord);
+            elements.setNode(0, 1, maxCoord, minCoord, minCoord);
+            elements.setNode(0, 2, maxCoord, maxCoord, minCoord);
+            elements.setNode(0, 3, minCoord, maxCoord, minCoord);
+            elements.setNode(0, 4, midCoord, midCoord, maxCoord);
+            // right angle pyramid
+            elements.setNode(1, 0, minCoord, minCoord, minCoord);
+            elements.setNode(1, 1, maxCoord, minCoord, minCoord);
+            elements.setNode(1, 2, maxCoord, maxCoord, minCoord);
+            elements.setNode(1, 3, minCoord, maxCoord, minCoord);
+            elements.setNode(1, 4, minCoord, minCoord, maxCoord);
+            return elements;
+        }
+        case ElementType::LINEAR_PRISM: {
+            ElementBatch elements(type, 2);
+            // Isosceles prism
+            elements.setNode(0, 0, minCoord, minCoord, minCoord);
+            elements.setNode(0, 1, maxCoord, minCoord, minCoord);
+            elements.setNode(0, 2, midCoord, maxCoord, minCoord);
+            elements.setNode(0, 3, minCoord, minCoord, maxCoord);
+            elements.setNode(0, 4, maxCoord, minCoord, maxCoord);
+            elements.setNode(0, 5, midCoord, maxCoord, maxCoord);
+            // right angle prism
+            elements.setNode(1, 0, minCoord, minCoord, minCoord);
+            elements.setNode(1, 1, maxCoord, minCoord, minCoord);
+            elements.setNode(1, 2, minCoord, maxCoord, minCoord);
+            elements.setNode(1, 3, minCoord, minCoord, maxCoord);
+            elements.setNode(1, 4, maxCoord, minCoord, maxCoord);
+            elements.setNode(1, 5, minCoord, maxCoord, maxCoord);
+            return elements;
+        }
+        default:
+            return ElementBatch(type);
+    }
+}
+
+ElementBatch getIdealElement(ElementType type, double minCoord, double maxCoord)
+{
+    double c = 0.5 * (minCoord + maxCoord);
+    double h = 0.25 * (maxCoord - minCoord);
+    ElementBatch ideal(type, 1);
+    switch (linearType(type)) {
+        case ElementType::LINEAR_TRIANGLE:
+            ideal.setNode(0, 0, c - h, c - h / std::sqrt(3.0), c);
+            ideal.setNode(0, 1, c + h, c - h / std::sqrt(3.0), c);
+            ideal.setNode(0, 2, c, c + 2.0 * h / std::sqrt(3.0), c);
+            break;
+        case ElementType::LINEAR_QUAD:
+            ideal.setNode(0, 0, c - h, c - h, c);
+            ideal.setNode(0, 1, c + h, c - h, c);
+            ideal.setNode(0, 2, c + h, c + h, c);
+            ideal.setNode(0, 3, c - h, c + h, c);
+            break;
+        case ElementType::LINEAR_TETRA:
+            ideal.setNode(0, 0, c - h, c - h, c - h);
+            ideal.setNode(0, 1, c + h, c - h, c + h);
+            ideal.setNode(0, 2, c + h, c + h, c - h);
+            ideal.setNode(0, 3, c - h, c + h, c + h);
+            break;
+        case ElementType::LINEAR_HEXA:
+            for (int k = 0; k < 8; ++k) {
+                ideal.setNode(0, k, (k % 4 == 1 || k % 4 == 2) ? c + h : c - h, (k % 4 >= 2) ? c + h : c - h, k >= 4 ? c + h : c - h);
+            }
+            break;
+        case ElementType::LINEAR_PYRAMID:
+            ideal.setNode(0, 0, c - h, c - h, c - h / std::sqrt(2.0));
+            ideal.setNode(0, 1, c + h, c - h, c - h / std::sqrt(2.0));
+            ideal.setNode(0, 2, c + h, c + h, c - h / std::sqrt(2.0));
+            ideal.setNode(0, 3, c - h, c + h, c - h / std::sqrt(2.0));
+            ideal.setNode(0, 4, c, c, c + h / std::sqrt(2.0));
+            break;
+        case ElementType::LINEAR_PRISM:
+            for (int k = 0; k < 6; ++k) {
+                double z = k < 3 ? c - h : c + h;
+                int v = k % 3;
+                ideal.setNode(0, k, v == 0 ? c - h : v == 1 ? c + h : c,
+                              v == 2 ? c + 2.0 * h / std::sqrt(3.0) : c - h / std::sqrt(3.0), z);
+            }
+            break;
+        default:
+            break;
+    }
+    return ideal;
+}
+
+namespace
+{
+
+// Last resort for elements[pending[k]], which hold their last rejected
+// candidate: move from the ideal shape towards that candidate by the largest
+// fraction, found by bisection, whose quality is still above a goal a
+// margin above the threshold, so the result is not left just at the edge of
+// degenerate. The ideal shape passes any threshold below 1 and both ends lie
+// in the bounds box, so the result is valid and inside the box.
+template <typename Traits>
+void pullTowardsIdeal(ElementBatch& elements, const std::vector<std::size_t>& pending, const GenerationOptions& options)
+{
+    const int BisectionSteps = 24;
+    const double Margin = 0.1;
+    double threshold = options.validity->minScaledJacobian;
+    double goal = threshold + Margin * (1.0 - threshold);
+    ElementBatch ideal = getIdealElement(elements.type, options.minCoord, options.maxCoord);
+    ElementBatch trial(elements.type);
+    QualityMetrics quality;
+    std::size_t n = pending.size();
+    std::vector<double> tIn(n, 0.0), tOut(n, 1.0), mid(n);
+
+    auto evaluate = [&](const std::vector<double>& t) {
+        trial.resize(n);
+        for (std::size_t k = 0; k < n; ++k) {
+            std::size_t e = pending[k];
+            for (int j = 0; j < Traits::Corners; ++j) {
+                trial.setNode(k, j, ideal.x(0, j) + t[k] * (elements.x(e, j) - ideal.x(0, j)),
+                              ideal.y(0, j) + t[k] * (elements.y(e, j) - ideal.y(0, j)),
+                              ideal.z(0, j) + t[k] * (elements.z(e, j) - ideal.z(0, j)));
+            }
+        }
+        computeQuality(trial, quality);
+    };
+
+    for (int step = 0; step < BisectionSteps; ++step) {
+        for (std::size_t k = 0; k < n; ++k) {
+            mid[k] = 0.5 * (tIn[k] + tOut[k]);
+        }
+        evaluate(mid);
+        for (std::size_t k = 0; k < n; ++k) {
+            (quality.scaledJacobian[k] > goal ? tIn[k] : tOut[k]) = mid[k];
+        }
+    }
+    evaluate(tIn);
+    for (std::size_t k = 0; k < n; ++k) {
+        elements.copyElement(pending[k], trial, k);
+    }
+}
+
+// Replace the corners of elements[pending[k]] by valid candidates. All
+// pending elements are tried together: candidate batch, quality in one pass,
+// keep the rejected ones for the next attempt. Attempt a of element index
+// draws from Philox sub-stream 2a, so attempt 0 is the unfiltered element.
+// Elements still rejected after maxAttempts are pulled towards the ideal
+// shape until they pass with a margin.
+template <typename Traits>
+void generateValidCorners(ElementBatch& elements, std::vector<std::size_t>& pending, std::uint64_t first,
+                          const GenerationOptions& options)
+{
+    ValidityFilter& validity = *options.validity;
+    ElementBatch candidates(elements.type);
+    QualityMetrics quality;
+    std::uint64_t tried = 0;
+    std::uint64_t passed = 0;
+    for (int attempt = 0; attempt < validity.maxAttempts && !pending.empty(); ++attempt) {
+        candidates.resize(pending.size());
+        for (std::size_t k = 0; k < pending.size(); ++k) {
+            PhiloxRng rng(options.seed, first + pending[k], 2 * static_cast<std::uint32_t>(attempt));
+            generateNodes<Traits>(candidates, k, options.minCoord, options.maxCoord, rng);
+        }
+        computeQuality(candidates, quality);
+        bool lastAttempt = attempt + 1 >= validity.maxAttempts;
+        std::size_t kept = 0;
+        for (std::size_t k = 0; k < pending.size(); ++k) {
+            ++tried;
+            bool valid = quality.scaledJacobian[k] > validity.minScaledJacobian;
+            if (valid || lastAttempt) {
+                elements.copyElement(pending[k], candidates, k);
+            }
+            if (valid) {
+                ++passed;
+            }
+            else {
+                pending[kept++] = pending[k];
+            }
+        }
+        pending.resize(kept);
+    }
+    if (!pending.empty()) {
+        pullTowardsIdeal<Traits>(elements, pending, options);
+    }
+    validity.record(elements.type, tried, passed, pending.size());
+}
+
+// Corners of elements[pending[k]] for the quality target. All pending
+// elements advance in lockstep so every bracketing and bisection step is one
+// batched quality pass. Direction a of element index comes from Philox
+// sub-stream 2a + 3: first the goal inside the bin, then the corner offsets.
+template <typename Traits>
+void generateTargetedCorners(ElementBatch& elements, std::vector<std::size_t> pending, std::uint64_t first,
+                             const GenerationOptions& options)
+{
+    const int BracketSteps = 6;
+    const int BisectionSteps = 24;
+    QualityTarget& target = *options.target;
+    const std::size_t corners = Traits::Corners;
+    double span = options.maxCoord - options.minCoord;
+    ElementBatch ideal = getIdealElement(elements.type, options.minCoord, options.maxCoord);
+    ElementBatch trial(elements.type);
+    QualityMetrics quality;
+
+    std::size_t n = pending.size();
+    std::vector<int> bin(n);
+    std::vector<double> goal(n), inside(n), outside(n), best(n), bestGap(n, 1e300);
+    std::vector<double> direction(n * corners * 3);
+    std::vector<std::uint64_t> evaluations(n, 0);
+    std::vector<std::size_t> slot(n);
+    for (std::size_t k = 0; k < n; ++k) {
+        slot[k] = k;
+        bin[k] = target.binOf(options.seed, first + pending[k]);
+    }
+
+    // shape of slot[k] at distance t[k] along its direction, clamped to the box
+    auto evaluate = [&](const std::vector<double>& t) {
+        trial.resize(slot.size());
+        for (std::size_t k = 0; k < slot.size(); ++k) {
+            const double* d = &direction[slot[k] * corners * 3];
+            for (int j = 0; j < Traits::Corners; ++j) {
+                double p[3] = { ideal.x(0, j) + t[k] * span * d[3 * j], ideal.y(0, j) + t[k] * span * d[3 * j + 1],
+                                ideal.z(0, j) + t[k] * span * d[3 * j + 2] };
+                for (double& v : p) {
+                    v = std::min(options.maxCoord, std::max(options.minCoord, v));
+                }
+                trial.setNode(k, j, p[0], p[1], p[2]);
+            }
+            ++evaluations[slot[k]];
+        }
+        computeQuality(trial, quality);
+    };
+
+    for (int attempt = 0; attempt < target.maxDirections && !slot.empty(); ++attempt) {
+        std::vector<double> tIn(slot.size(), 0.0), tOut(slot.size(), 0.125);
+        for (std::size_t k = 0; k < slot.size(); ++k) {
+            std::size_t e = slot[k];
+            PhiloxRng rng(options.seed, first + pending[e], 2 * static_cast<std::uint32_t>(attempt) + 3);
+            const QualityTarget::Bin& b = target.bins()[static_cast<std::size_t>(bin[e])];
+            goal[e] = rng.uniform(b.low, b.high);
+            rng.fill(&direction[e * corners * 3], corners * 3, -1.0, 1.0);
+        }
+        // push the outer point out until its quality drops below the goal
+        for (int step = 0; step < BracketSteps; ++step) {
+            evaluate(tOut);
+            for (std::size_t k = 0; k < slot.size(); ++k) {
+                if (quality.scaledJacobian[k] >= goal[slot[k]]) {
+                    tIn[k] = tOut[k];
+                    tOut[k] *= 2.0;
+                }
+            }
+        }
+        for (int step = 0; step < BisectionSteps; ++step) {
+            std::vector<double> mid(slot.size());
+            for (std::size_t k = 0; k < slot.size(); ++k) {
+                mid[k] = 0.5 * (tIn[k] + tOut[k]);
+            }
+            evaluate(mid);
+            for (std::size_t k = 0; k < slot.size(); ++k) {
+                (quality.scaledJacobian[k] >= goal[slot[k]] ? tIn[k] : tOut[k]) = mid[k];
+            }
+        }
+        evaluate(tIn);
+        std::size_t kept = 0;
+        std::vector<double> keptIn;
+        for (std::size_t k = 0; k < slot.size(); ++k) {
+            std::size_t e = slot[k];
+            const QualityTarget::Bin& b = target.bins()[static_cast<std::size_t>(bin[e])];
+            double q = quality.scaledJacobian[k];
+            double gap = q < b.low ? b.low - q : q > b.high ? q - b.high : 0.0;
+            if (gap < bestGap[e]) {
+                bestGap[e] = gap;
+                elements.copyElement(pending[e], trial, k);
+            }
+            if (gap > 0.0) {
+                slot[kept++] = e;
+            }
+            else {
+                target.record(bin[e], evaluations[e], false);
+            }
+        }
+        slot.resize(kept);
+    }
+    for (std::size_t e : slot) {
+        target.record(bin[e], evaluations[e], true);
+    }
+}
+
+// Elements begin .. end-1 of the batch, i.e. run indices first+begin ..,
+// on the calling thread. The first indices of a run are the standard shapes
+// (never targeted; under the validity filter a standard shape that fails it
+// is replaced like a random element). Every other element takes its corners from
+// Philox stream (seed, index), or from the validity / target sub-streams of
+// the same index, and its midside perturbations from the perturbation
+// stream of the index, so no earlier element has to be generated.
+template <typename Traits>
+void generateChunk(ElementBatch& elements, std::size_t begin, std::size_t end, std::uint64_t first,
+                   const ElementBatch& standard, const GenerationOptions& options)
+{
+    INSTRUMENT_TIMER(Generate);
+    INSTRUMENT_COUNT(Elements, end - begin);
+    INSTRUMENT_COUNT(Nodes, (end - begin) * Traits::Nodes);
+    bool deferred = options.target != nullptr || options.validity != nullptr;
+    std::vector<std::size_t> pending;
+    QualityMetrics standardQuality;
+    if (options.validity != nullptr && first + begin < standard.size()) {
+        computeQuality(standard, standardQuality);
+    }
+    auto keepStandard = [&](std::uint64_t index) {
+        return options.validity == nullptr ||
+               standardQuality.scaledJacobian[static_cast<std::size_t>(index)] > options.validity->minScaledJacobian;
+    };
+    {
+        INSTRUMENT_TIMER(Corners);
+        for (std::size_t i = begin; i < end; ++i) {
+            std::uint64_t index = first + i;
+            if (index < standard.size() && keepStandard(index)) {
+                elements.copyElement(i, standard, static_cast<std::size_t>(index));
+            }
+            else if (deferred) {
+                pending.push_back(i);
+            }
+            else {
+                PhiloxRng rng(options.seed, index);
+                generateNodes<Traits>(elements, i, options.minCoord, options.maxCoord, rng);
+            }
+        }
+    }
+    if (options.target != nullptr) {
+        INSTRUMENT_TIMER(QualityTarget);
+        generateTargetedCorners<Traits>(elements, pending, first, options);
+    }
+    else if (options.validity != nullptr) {
+        INSTRUMENT_TIMER(Validity);
+        generateValidCorners<Traits>(elements, pending, first, options);
+    }
+    if constexpr (Traits::Midside > 0) {
+        INSTRUMENT_TIMER(Midside);
+        PerturbationEngine engine(options.seed);
+        for (std::size_t i = begin; i < end; ++i) {
+            if (first + i >= standard.size()) {
+                engine.seek(first + i);
+                addQuadraticNodes<Traits>(elements, i, engine);
+            }
+        }
+    }
+}
+
+} // namespace
+
+void generateElementRange(ElementBatch& elements, std::uint64_t first, const ElementBatch& standard,
+                          const GenerationOptions& options, ThreadPool& pool)
+{
+    withElementTraits(elements.type, [&](auto traits) {
+        using Traits = decltype(traits);
+        pool.parallelFor(elements.size(), 4096, [&](unsigned, std::size_t begin, std::size_t end) {
+            generateChunk<Traits>(elements, begin, end, first, standard, options);
+        });
+    });
+}
+
+ElementBatch generateElementRange(ElementType type, std::uint64_t first, std::size_t count,
+                                  const GenerationOptions& options, ThreadPool& pool)
+{
+    ElementBatch standard = getStandardElement(type, options.minCoord, options.maxCoord);
+    try {
+        ElementBatch elements(type);
+        {
+            INSTRUMENT_TIMER(Allocate);
+            elements.resize(count);
+        }
+        generateElementRange(elements, first, standard, options, pool);
+        return elements;
+    }
+    catch (const std::bad_alloc& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return ElementBatch(type);
+    }
+}
+
+ElementBatch generateElement(ElementType type, std::uint64_t index, const GenerationOptions& options)
+{
+    ThreadPool serial(1);
+    return generateElementRange(type, index, 1, options, serial);
+}
+
+ElementBatch generateElement(std::uint64_t seed, ElementType type, std::uint64_t index, double minCoord, double maxCoord)
+{
+    GenerationOptions options;
+    options.minCoord = minCoord;
+    options.maxCoord = maxCoord;
+    options.seed = seed;
+    return generateElement(type, index, options);
+}
+
+ElementBatch generateElements(ElementType type, int numElements, double minCoord, double maxCoord, std::uint64_t seed) {
+    GenerationOptions options;
+    options.minCoord = minCoord;
+    options.maxCoord = maxCoord;
+    options.seed = seed;
+    ThreadPool serial(1);
+    std::size_t total = numElements > 0 ? static_cast<std::size_t>(numElements) : 0;
+    return generateElementRange(type, 0, total, options, serial);
+}
+
+bool streamElements(ElementType type, std::uint64_t first, std::uint64_t count, const GenerationOptions& options,
+                    ThreadPool& pool, std::size_t batchSize, std::size_t queueDepth, const ElementSink& sink)
+{
+    struct StreamBatch
+    {
+        ElementBatch elements;
+        std::uint64_t first;
+    };
+    using BatchPtr = std::unique_ptr<StreamBatch>;
+
+    if (batchSize == 0) {
+        batchSize = 1;
+    }
+    std::uint64_t numBatches = count / batchSize + (count % batchSize != 0 ? 1 : 0);
+    ElementBatch standard = getStandardElement(type, options.minCoord, options.maxCoord);
+    try {
+        // one batch at a time; the pool works inside it
+        return streamPipeline<StreamBatch>(
+            numBatches, 1, queueDepth, [&] { return BatchPtr(new StreamBatch{ ElementBatch(type), 0 }); },
+            [&](std::vector<BatchPtr>& batches, std::uint64_t b, std::size_t) {
+                StreamBatch& batch = *batches[0];
+                std::uint64_t done = b * batchSize;
+                std::uint64_t left = count - done;
+                {
+                    INSTRUMENT_TIMER(Allocate);
+                    batch.elements.resize(left < batchSize ? static_cast<std::size_t>(left) : batchSize);
+                }
+                batch.first = first + done;
+                generateElementRange(batch.elements, batch.first, standard, options, pool);
+            },
+            [&](const StreamBatch& batch) { return sink(batch.elements, batch.first); });
+    }
+    catch (const std::bad_alloc& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool parseElementType(const std::string& name, ElementType& type)
+{
+    for (int t = 0; t < NumElementTypes; ++t)
+    {
+        if (name == elementTypeName(static_cast<ElementType>(t)))
+        {
+            type = static_cast<ElementType>(t);
+            return true;
+        }
+    }
+    return false;
+}
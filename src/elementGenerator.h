@@ -0,0 +1,677 @@
+// Random element generation: counter-based random streams, corner and
+// midside node placement, the optional validity filter and quality target,
+// and the parallel / streaming drivers. Element index of a run depends only
+// on (seed, type, index, GenerationOptions), never on other elements.
+#ifndef ELEMENT_GENERATOR_H
+#define ELEMENT_GENERATOR_H
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "elementBatch.h"
+
+// Counter-based Philox4x32-10 generator. The output is a pure function of
+// (seed, stream, counter), so each element can own an independent stream
+// without any shared state between threads.
+class PhiloxRng
+{
+public:
+    PhiloxRng(std::uint64_t seed, std::uint64_t stream, std::uint32_t subStream = 0)
+        : key{ static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32) },
+          counter{ 0, subStream, static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32) }
+    {
+    }
+
+    std::uint32_t next32()
+    {
+        if (used == 4)
+        {
+            refill();
+        }
+        return block[used++];
+    }
+
+    // uniform deviate in [0, 1) with 53 random bits
+    double uniform()
+    {
+        std::uint64_t hi = next32() >> 5;
+        std::uint64_t lo = next32() >> 6;
+        return static_cast<double>((hi << 26) | lo) * (1.0 / 9007199254740992.0);
+    }
+
+    double uniform(double low, double up)
+    {
+        return low + uniform() * (up - low);
+    }
+
+    // Restart at the first block of another stream
+    void seek(std::uint64_t stream, std::uint32_t subStream = 0)
+    {
+        counter[0] = 0;
+        counter[1] = subStream;
+        counter[2] = static_cast<std::uint32_t>(stream);
+        counter[3] = static_cast<std::uint32_t>(stream >> 32);
+        used = 4;
+    }
+
+    // Fill out[0..n) with uniform deviates in [low, up), starting at the next
+    // whole block. Up to Lanes blocks are computed per pass, interleaved so
+    // their rounds overlap, and only as many blocks as n needs.
+    void fill(double* out, std::size_t n, double low, double up)
+    {
+        constexpr std::size_t Lanes = 8;
+        const double scale = (up - low) * (1.0 / 9007199254740992.0);
+        used = 4;
+        while (n > 0)
+        {
+            std::size_t take = n < 2 * Lanes ? n : 2 * Lanes;
+            std::size_t blocks = (take + 1) / 2;
+            std::uint32_t c0[Lanes], c1[Lanes], c2[Lanes], c3[Lanes];
+            for (std::size_t l = 0; l < blocks; ++l)
+            {
+                c0[l] = counter[0] + static_cast<std::uint32_t>(l);
+                c1[l] = counter[1];
+                c2[l] = counter[2];
+                c3[l] = counter[3];
+            }
+            std::uint32_t k0 = key[0];
+            std::uint32_t k1 = key[1];
+            for (int round = 0; round < 10; ++round)
+            {
+                for (std::size_t l = 0; l < blocks; ++l)
+                {
+                    std::uint64_t p0 = static_cast<std::uint64_t>(0xD2511F53u) * c0[l];
+                    std::uint64_t p1 = static_cast<std::uint64_t>(0xCD9E8D57u) * c2[l];
+                    std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1[l] ^ k0;
+                    std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3[l] ^ k1;
+                    c0[l] = n0;
+                    c1[l] = static_cast<std::uint32_t>(p1);
+                    c2[l] = n2;
+                    c3[l] = static_cast<std::uint32_t>(p0);
+                }
+                k0 += 0x9E3779B9u;
+                k1 += 0xBB67AE85u;
+            }
+            // two deviates per block
+            double dev[2 * Lanes];
+            for (std::size_t l = 0; l < blocks; ++l)
+            {
+                std::uint64_t a = (static_cast<std::uint64_t>(c0[l] >> 5) << 26) | (c1[l] >> 6);
+                std::uint64_t b = (static_cast<std::uint64_t>(c2[l] >> 5) << 26) | (c3[l] >> 6);
+                dev[2 * l] = low + static_cast<double>(a) * scale;
+                dev[2 * l + 1] = low + static_cast<double>(b) * scale;
+            }
+            for (std::size_t i = 0; i < take; ++i)
+            {
+                out[i] = dev[i];
+            }
+            counter[0] += static_cast<std::uint32_t>(blocks);
+            out += take;
+            n -= take;
+        }
+    }
+
+private:
+    void refill()
+    {
+        std::uint32_t c[4] = { counter[0], counter[1], counter[2], counter[3] };
+        std::uint32_t k[2] = { key[0], key[1] };
+        for (int round = 0; round < 10; ++round)
+        {
+            std::uint64_t p0 = static_cast<std::uint64_t>(0xD2511F53u) * c[0];
+            std::uint64_t p1 = static_cast<std::uint64_t>(0xCD9E8D57u) * c[2];
+            std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c[1] ^ k[0];
+            std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c[3] ^ k[1];
+            c[0] = n0;
+            c[1] = static_cast<std::uint32_t>(p1);
+            c[2] = n2;
+            c[3] = static_cast<std::uint32_t>(p0);
+            k[0] += 0x9E3779B9u;
+            k[1] += 0xBB67AE85u;
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            block[i] = c[i];
+        }
+        used = 0;
+        ++counter[0];
+    }
+
+    std::uint32_t key[2];
+    std::uint32_t counter[4];
+    std::uint32_t block[4] = { 0, 0, 0, 0 };
+    int used = 4;
+};
+
+// Reusable source of midside perturbations. Holds one Philox generator per
+// user seed; all deviates of an element are drawn in a single fill() call
+// from the element's own perturbation stream.
+class PerturbationEngine
+{
+public:
+    explicit PerturbationEngine(std::uint64_t seed, double disturbScale = 0.15)
+        : scale(disturbScale), rng(seed, 0, 1)
+    {
+    }
+
+    // Position the engine on the perturbation stream of element index elm
+    void seek(std::uint64_t elm) { rng.seek(elm, 1); }
+
+    // Fill out[0..n) with uniform deviates in [-1, 1)
+    void draw(double* out, std::size_t n) { rng.fill(out, n, -1.0, 1.0); }
+
+    // fraction of the edge span a midside node may move per coordinate
+    double scale;
+
+private:
+    PhiloxRng rng;
+};
+
+// Fixed set of worker threads that run chunked loops. The calling thread
+// takes part in every loop, so a pool of size 1 has no extra threads.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned numThreads)
+    {
+        unsigned extra = numThreads > 1 ? numThreads - 1 : 0;
+        for (unsigned i = 0; i < extra; ++i)
+        {
+            workers.emplace_back([this, i] { workerLoop(i + 1); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers)
+        {
+            t.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Call body(worker, begin, end) over [0, count) in chunks of chunkSize and
+    // return once every chunk is done. worker is in [0, size()). If body
+    // throws, no further chunks are started and the first exception is
+    // rethrown on the calling thread once every worker has stopped.
+    void parallelFor(std::size_t count, std::size_t chunkSize,
+                     const std::function<void(unsigned, std::size_t, std::size_t)>& body)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        if (chunkSize == 0)
+        {
+            chunkSize = 1;
+        }
+        if (workers.empty() || count <= chunkSize)
+        {
+            body(0, 0, count);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &body;
+            jobCount = count;
+            jobChunk = chunkSize;
+            next = 0;
+            busy = static_cast<unsigned>(workers.size());
+            error = nullptr;
+            ++generation;
+        }
+        wake.notify_all();
+        runChunks(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busy == 0; });
+        job = nullptr;
+        if (error)
+        {
+            std::exception_ptr thrown = error;
+            error = nullptr;
+            lock.unlock();
+            std::rethrow_exception(thrown);
+        }
+    }
+
+private:
+    void runChunks(unsigned worker)
+    {
+        for (;;)
+        {
+            std::size_t begin = next.fetch_add(jobChunk);
+            if (begin >= jobCount)
+            {
+                return;
+            }
+            std::size_t end = begin + jobChunk < jobCount ? begin + jobChunk : jobCount;
+            try
+            {
+                (*job)(worker, begin, end);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+                next = jobCount;
+            }
+        }
+    }
+
+    void workerLoop(unsigned worker)
+    {
+        std::uint64_t seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = generation;
+            }
+            runChunks(worker);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --busy;
+            }
+            done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(unsigned, std::size_t, std::size_t)>* job = nullptr;
+    std::size_t jobCount = 0;
+    std::size_t jobChunk = 1;
+    std::atomic<std::size_t> next{ 0 };
+    std::exception_ptr error;
+    unsigned busy = 0;
+    std::uint64_t generation = 0;
+    bool stopping = false;
+};
+
+// Fixed-capacity FIFO between threads. push blocks while the queue is full,
+// pop blocks while it is empty; after close() pushes fail and pops drain
+// what is left.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(std::size_t queueCapacity) : capacity(queueCapacity > 0 ? queueCapacity : 1) {}
+
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed)
+        {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty())
+        {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    std::size_t capacity;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    bool closed = false;
+};
+
+// Pipeline of the streaming drivers. numItems items are filled in order,
+// group at a time, by produce(items, firstItem, n) on the calling thread
+// (items[0 .. n-1] become items firstItem ..), and handed to consume(item) on
+// a separate writer thread. At most queueDepth + group + 1 items exist at
+// any time: make() creates them, after that they are recycled. false if
+// consume failed; an exception of produce is rethrown once the writer has
+// stopped.
+template <typename Item, typename Make, typename Produce, typename Consume>
+bool streamPipeline(std::uint64_t numItems, std::size_t group, std::size_t queueDepth, Make make, Produce produce,
+                    Consume consume)
+{
+    using ItemPtr = std::unique_ptr<Item>;
+    if (group == 0)
+    {
+        group = 1;
+    }
+    std::size_t capacity = queueDepth + group + 1;
+    BoundedQueue<ItemPtr> full(queueDepth);
+    BoundedQueue<ItemPtr> spare(capacity);
+    std::atomic<bool> failed{ false };
+
+    std::thread writer([&] {
+        ItemPtr item;
+        while (full.pop(item))
+        {
+            if (!failed && !consume(static_cast<const Item&>(*item)))
+            {
+                failed = true;
+            }
+            spare.push(std::move(item));
+        }
+    });
+
+    try
+    {
+        std::vector<ItemPtr> ready(group);
+        std::size_t allocated = 0;
+        bool stopped = false;
+        for (std::uint64_t i = 0; i < numItems && !failed && !stopped; i += group)
+        {
+            std::size_t n = numItems - i < group ? static_cast<std::size_t>(numItems - i) : group;
+            for (std::size_t k = 0; k < n && !stopped; ++k)
+            {
+                if (allocated < capacity)
+                {
+                    ready[k] = make();
+                    ++allocated;
+                }
+                else if (!spare.pop(ready[k]))
+                {
+                    stopped = true;
+                }
+            }
+            if (stopped)
+            {
+                break;
+            }
+            produce(ready, i, n);
+            for (std::size_t k = 0; k < n && !stopped; ++k)
+            {
+                stopped = !full.push(std::move(ready[k]));
+            }
+        }
+    }
+    catch (...)
+    {
+        full.close();
+        writer.join();
+        throw;
+    }
+    full.close();
+    writer.join();
+    return !failed;
+}
+
+// Generate random node coordination for the corner nodes of element elm
+template <typename Traits>
+void generateNodes(ElementBatch& batch, std::size_t elm, double minCoord, double maxCoord, PhiloxRng& rng)
+{
+    for (int i = 0; i < Traits::Corners; ++i)
+    {
+        batch.x(elm, i) = rng.uniform(minCoord, maxCoord); // x
+        batch.y(elm, i) = rng.uniform(minCoord, maxCoord); // y
+        batch.z(elm, i) = rng.uniform(minCoord, maxCoord); // z
+    }
+}
+
+// quadratic points moved at 1/4 edge length area; u is a deviate in [-1, 1)
+inline double random_disturb_num(double low, double up, double u, double scale = 0.15)
+{
+    return std::abs(up - low) * scale * u;
+}
+
+// Fill the midside nodes of element elm from its corner nodes, midside node
+// k on edge Traits::Edges[k]. All deviates of the element are drawn from
+// engine up front, then applied per edge.
+template <typename Traits>
+void addQuadraticNodes(ElementBatch& batch, std::size_t elm, PerturbationEngine& engine)
+{
+    if constexpr (Traits::Midside > 0)
+    {
+        double deviates[3 * Traits::Midside];
+        engine.draw(deviates, 3 * Traits::Midside);
+        double* coord[3] = { batch.xData(), batch.yData(), batch.zData() };
+        for (int k = 0; k < Traits::Midside; ++k)
+        {
+            std::size_t m = batch.nodeIndex(elm, Traits::Corners + k);
+            std::size_t na = batch.nodeIndex(elm, Traits::Edges[k][0]);
+            std::size_t nb = batch.nodeIndex(elm, Traits::Edges[k][1]);
+            for (int d = 0; d < 3; ++d)
+            {
+                double* c = coord[d];
+                c[m] = 0.5 * (c[na] + c[nb]) + random_disturb_num(c[na], c[nb], deviates[3 * k + d], engine.scale);
+            }
+        }
+    }
+}
+
+// Hand-made reference shapes of each linear type; quadratic types have none
+ElementBatch getStandardElement(ElementType type, double minCoord, double maxCoord);
+
+// Optional rejection of random candidates whose minimum scaled Jacobian is
+// not above minScaledJacobian (0 = reject inverted and degenerate elements),
+// which must be below 1. After maxAttempts candidates the element is the
+// ideal shape moved towards the last candidate as far as a scaled Jacobian
+// of threshold + 0.1 * (1 - threshold) allows, and is counted as exhausted.
+// Standard shapes that fail the filter are replaced like random elements. The counters are per element type and
+// safe to update from several threads.
+class ValidityFilter
+{
+public:
+    explicit ValidityFilter(double minJacobian = 0.0, int attempts = 1000)
+        : minScaledJacobian(minJacobian), maxAttempts(attempts > 0 ? attempts : 1)
+    {
+    }
+
+    void record(ElementType type, std::uint64_t tried, std::uint64_t passed, std::uint64_t gaveUp)
+    {
+        int t = static_cast<int>(type);
+        candidates[t] += tried;
+        accepted[t] += passed;
+        exhausted[t] += gaveUp;
+    }
+
+    std::uint64_t numCandidates(ElementType type) const { return candidates[static_cast<int>(type)]; }
+    std::uint64_t numAccepted(ElementType type) const { return accepted[static_cast<int>(type)]; }
+    std::uint64_t numExhausted(ElementType type) const { return exhausted[static_cast<int>(type)]; }
+
+    double minScaledJacobian;
+    int maxAttempts;
+
+private:
+    std::atomic<std::uint64_t> candidates[NumElementTypes] = {};
+    std::atomic<std::uint64_t> accepted[NumElementTypes] = {};
+    std::atomic<std::uint64_t> exhausted[NumElementTypes] = {};
+};
+
+// Target histogram of the minimum scaled Jacobian. Element index goes to a
+// bin by golden-ratio stratification of the index, so every run and every
+// range of a run follows the requested fractions closely, and its goal
+// quality is drawn uniformly inside the bin. The element is then the ideal
+// shape moved along a random direction by the distance that gives the goal
+// quality, found by bisection; no samples are thrown away unless a
+// direction cannot reach the goal. Counters are safe to update from several
+// threads.
+class QualityTarget
+{
+public:
+    struct Bin
+    {
+        double low;
+        double high;
+        double fraction;
+    };
+
+    // "low:high:fraction,..." e.g. "0:0.2:0.2,0.2:0.7:0.6,0.7:1:0.2";
+    // fractions are normalised. false if the text is malformed.
+    bool parse(const std::string& spec)
+    {
+        std::vector<Bin> parsed;
+        double total = 0.0;
+        std::size_t begin = 0;
+        while (begin < spec.size()) {
+            std::size_t comma = spec.find(',', begin);
+            std::string item = spec.substr(begin, comma == std::string::npos ? std::string::npos : comma - begin);
+            Bin bin;
+            char extra = 0;
+            if (std::sscanf(item.c_str(), "%lf:%lf:%lf%c", &bin.low, &bin.high, &bin.fraction, &extra) != 3 ||
+                !(bin.low < bin.high) || !(bin.fraction >= 0.0)) {
+                return false;
+            }
+            total += bin.fraction;
+            parsed.push_back(bin);
+            if (comma == std::string::npos) {
+                break;
+            }
+            begin = comma + 1;
+        }
+        if (parsed.empty() || !(total > 0.0)) {
+            return false;
+        }
+        for (Bin& bin : parsed) {
+            bin.fraction /= total;
+        }
+        binList = parsed;
+        produced = std::vector<std::atomic<std::uint64_t>>(binList.size());
+        return true;
+    }
+
+    const std::vector<Bin>& bins() const { return binList; }
+
+    int binOf(std::uint64_t seed, std::uint64_t index) const
+    {
+        std::uint64_t offset = (seed * 0x9E3779B97F4A7C15ull) >> 11;
+        double u = static_cast<double>(offset) * (1.0 / 9007199254740992.0) + static_cast<double>(index) * 0.6180339887498949;
+        u -= std::floor(u);
+        double cumulative = 0.0;
+        for (std::size_t b = 0; b + 1 < binList.size(); ++b) {
+            cumulative += binList[b].fraction;
+            if (u < cumulative) {
+                return static_cast<int>(b);
+            }
+        }
+        return static_cast<int>(binList.size()) - 1;
+    }
+
+    void record(int bin, std::uint64_t numEvaluations, bool missed)
+    {
+        ++produced[static_cast<std::size_t>(bin)];
+        evaluations += numEvaluations;
+        if (missed) {
+            ++misses;
+        }
+    }
+
+    std::uint64_t numProduced(int bin) const { return produced[static_cast<std::size_t>(bin)]; }
+    std::uint64_t numEvaluations() const { return evaluations; }
+    std::uint64_t numMisses() const { return misses; }
+
+    // random directions tried per element before the closest miss is kept
+    int maxDirections = 20;
+
+private:
+    std::vector<Bin> binList;
+    std::vector<std::atomic<std::uint64_t>> produced;
+    std::atomic<std::uint64_t> evaluations{ 0 };
+    std::atomic<std::uint64_t> misses{ 0 };
+};
+
+// How the elements of a run are generated. Element index of a run is a pure
+// function of its type, its index and these options.
+struct GenerationOptions
+{
+    double minCoord = 0.0;
+    double maxCoord = 10.0;
+    std::uint64_t seed = 0;
+    ValidityFilter* validity = nullptr; // reject invalid random candidates
+    QualityTarget* target = nullptr;    // hit a quality histogram instead of uniform corners;
+                                        // replaces the validity filter, so set only one
+};
+
+// Ideal corners of each shape (scaled Jacobian 1 at every corner), half the
+// size of the box and centred in it, positively oriented
+ElementBatch getIdealElement(ElementType type, double minCoord, double maxCoord);
+
+// Fill elements with elements first .. first+elements.size()-1 of the run,
+// split into chunks on pool. The result does not depend on the number of
+// threads.
+void generateElementRange(ElementBatch& elements, std::uint64_t first, const ElementBatch& standard,
+                          const GenerationOptions& options, ThreadPool& pool);
+
+// Elements first .. first+count-1 of the run in a new batch; an empty batch
+// if it cannot be allocated
+ElementBatch generateElementRange(ElementType type, std::uint64_t first, std::size_t count,
+                                  const GenerationOptions& options, ThreadPool& pool);
+
+// Single element index of a run with these options, identical to the same
+// index of a full run, including --valid and --quality-target runs (the
+// filter and target counters are updated as in a run)
+ElementBatch generateElement(ElementType type, std::uint64_t index, const GenerationOptions& options);
+
+// Single element index of a plain run (seed, type, bounds)
+ElementBatch generateElement(std::uint64_t seed, ElementType type, std::uint64_t index,
+                             double minCoord = 0.0, double maxCoord = 10.0);
+
+// Standard shapes first, the remaining elements get random nodes
+ElementBatch generateElements(ElementType type, int numElements, double minCoord, double maxCoord, std::uint64_t seed);
+
+// Receives consecutive batches of a run; firstIndex is the run index of the
+// batch's first element. Returning false stops the run.
+using ElementSink = std::function<bool(const ElementBatch& batch, std::uint64_t firstIndex)>;
+
+// Generate elements first .. first+count-1 in batches of batchSize and hand
+// them to sink on a separate writer thread, so the next batches are generated
+// while earlier ones are written. At most queueDepth + 2 batches exist at any
+// time, whatever count is; they are recycled rather than reallocated.
+bool streamElements(ElementType type, std::uint64_t first, std::uint64_t count, const GenerationOptions& options,
+                    ThreadPool& pool, std::size_t batchSize, std::size_t queueDepth, const ElementSink& sink);
+
+// Element type from its name, e.g. "LINEAR_HEXA"; false if unknown
+bool parseElementType(const std::string& name, ElementType& type);
+
+#endif
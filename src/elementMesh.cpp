@@ -0,0 +1,370 @@
+#include "elementMesh.h"
+
+#include <iostream>
+#include <memory>
+#include <new>
+
+#include "instrumentation.h"
+
+namespace
+{
+
+// Elements of one grid cell in their own corner order, positively oriented.
+// Cell corner c is the vertex at offset (c & 1, c >> 1 & 1, c >> 2 & 1) from
+// the lower corner of the cell. Types without a split have no elements.
+template <ElementType Linear>
+struct CellPattern
+{
+    static constexpr int Elements = 0;
+};
+
+template <>
+struct CellPattern<ElementType::LINEAR_TRIANGLE>
+{
+    static constexpr int Elements = 2;
+    static constexpr int Corners[Elements][3] = { {0, 1, 3}, {0, 3, 2} };
+};
+
+template <>
+struct CellPattern<ElementType::LINEAR_QUAD>
+{
+    static constexpr int Elements = 1;
+    static constexpr int Corners[Elements][4] = { {0, 1, 3, 2} };
+};
+
+// Kuhn split along the cell diagonal 0-7, one tetra per order of the axes;
+// odd orders have corners 1 and 2 swapped to keep them positively oriented
+template <>
+struct CellPattern<ElementType::LINEAR_TETRA>
+{
+    static constexpr int Elements = 6;
+    static constexpr int Corners[Elements][4] = { {0, 1, 3, 7}, {0, 5, 1, 7}, {0, 3, 2, 7},
+                                                  {0, 2, 6, 7}, {0, 4, 5, 7}, {0, 6, 4, 7} };
+};
+
+template <>
+struct CellPattern<ElementType::LINEAR_HEXA>
+{
+    static constexpr int Elements = 1;
+    static constexpr int Corners[Elements][8] = { {0, 1, 3, 2, 4, 5, 7, 6} };
+};
+
+template <>
+struct CellPattern<ElementType::LINEAR_PRISM>
+{
+    static constexpr int Elements = 2;
+    static constexpr int Corners[Elements][6] = { {0, 1, 3, 4, 5, 7}, {0, 3, 2, 4, 7, 6} };
+};
+
+// Grid of a mesh; 2D types have a single vertex layer along z. Vertex
+// (i, j, k) has index i + vertices[0] * (j + vertices[1] * k). A grid edge
+// goes from its lower vertex in direction d (bit a set = one step along axis
+// a), and the cell splits only use directions whose steps are all positive.
+// The edges of direction d are numbered like the vertices they start from,
+// after the edges of lower directions, which gives every shared edge one
+// midside node without any lookup table.
+struct MeshGrid
+{
+    std::uint64_t cells[3];
+    std::uint64_t vertices[3];
+    int slabAxis;                   // partitions are layers of cells along this axis
+    std::uint64_t cellsPerLayer;
+    std::uint64_t verticesPerLayer;
+    std::uint64_t cornerOffset[8];  // vertex index of cell corner c minus that of corner 0
+    double origin[3];
+    double step[3];
+    double jitter;
+    std::uint64_t seed;
+    unsigned directions;            // bit d set if the elements have edges of direction d
+    std::uint64_t edgeOffset[8];
+    std::uint64_t numVertices;
+    std::uint64_t numEdges;
+};
+
+template <typename Traits>
+MeshGrid makeGrid(const MeshOptions& options)
+{
+    using Pattern = CellPattern<Traits::Linear>;
+    MeshGrid grid;
+    bool planar = Traits::Dim == 2;
+    for (int a = 0; a < 3; ++a) {
+        bool flat = planar && a == 2;
+        grid.cells[a] = flat ? 1 : options.cells[a];
+        grid.vertices[a] = flat ? 1 : options.cells[a] + 1;
+        grid.origin[a] = flat ? 0.5 * (options.minCoord + options.maxCoord) : options.minCoord;
+        grid.step[a] = flat || options.cells[a] == 0 ? 0.0 : (options.maxCoord - options.minCoord) / static_cast<double>(options.cells[a]);
+    }
+    grid.slabAxis = planar ? 1 : 2;
+    grid.cellsPerLayer = planar ? grid.cells[0] : grid.cells[0] * grid.cells[1];
+    grid.verticesPerLayer = planar ? grid.vertices[0] : grid.vertices[0] * grid.vertices[1];
+    for (int c = 0; c < 8; ++c) {
+        grid.cornerOffset[c] = static_cast<std::uint64_t>(c & 1) + grid.vertices[0] * (static_cast<std::uint64_t>(c >> 1 & 1) + grid.vertices[1] * static_cast<std::uint64_t>(c >> 2 & 1));
+    }
+    grid.jitter = options.jitter;
+    grid.seed = options.seed;
+    grid.directions = 0;
+    if constexpr (Traits::Midside > 0) {
+        for (int e = 0; e < Pattern::Elements; ++e) {
+            for (int k = 0; k < Traits::NumEdges; ++k) {
+                grid.directions |= 1u << (Pattern::Corners[e][Traits::Edges[k][0]] ^ Pattern::Corners[e][Traits::Edges[k][1]]);
+            }
+        }
+    }
+    grid.numVertices = grid.vertices[0] * grid.vertices[1] * grid.vertices[2];
+    grid.numEdges = 0;
+    for (int d = 0; d < 8; ++d) {
+        grid.edgeOffset[d] = grid.numEdges;
+        if (grid.directions & (1u << d)) {
+            grid.numEdges += (grid.vertices[0] - (d & 1)) * (grid.vertices[1] - (d >> 1 & 1)) * (grid.vertices[2] - (d >> 2 & 1));
+        }
+    }
+    return grid;
+}
+
+void vertexIndices(const MeshGrid& grid, std::uint64_t v, std::uint64_t ijk[3])
+{
+    ijk[0] = v % grid.vertices[0];
+    ijk[1] = v / grid.vertices[0] % grid.vertices[1];
+    ijk[2] = v / (grid.vertices[0] * grid.vertices[1]);
+}
+
+// Jittered coordinates of vertex v from its own Philox stream. Boundary
+// vertices only move within their boundary faces, so the mesh fills the box.
+void vertexCoordinates(const MeshGrid& grid, std::uint64_t v, double* p)
+{
+    std::uint64_t ijk[3];
+    vertexIndices(grid, v, ijk);
+    PhiloxRng rng(grid.seed, v);
+    for (int a = 0; a < 3; ++a) {
+        double u = rng.uniform(-1.0, 1.0);
+        p[a] = grid.origin[a] + static_cast<double>(ijk[a]) * grid.step[a];
+        if (ijk[a] > 0 && ijk[a] + 1 < grid.vertices[a]) {
+            p[a] += grid.jitter * grid.step[a] * u;
+        }
+    }
+}
+
+std::uint64_t edgeIndex(const MeshGrid& grid, const std::uint64_t lower[3], int d)
+{
+    std::uint64_t n0 = grid.vertices[0] - (d & 1);
+    std::uint64_t n1 = grid.vertices[1] - (d >> 1 & 1);
+    return grid.edgeOffset[d] + lower[0] + n0 * (lower[1] + n1 * lower[2]);
+}
+
+// Midside node of edge from its end points a (lower) and b, perturbed as in
+// addQuadraticNodes but from the perturbation stream of the edge, so every
+// element on the edge gets the same node. Coordinates normal to a boundary
+// face that contains the edge are not perturbed.
+void midsideCoordinates(const MeshGrid& grid, const std::uint64_t lower[3], int d, std::uint64_t edge,
+                        const double* a, const double* b, PerturbationEngine& engine, double* m)
+{
+    double deviates[3];
+    engine.seek(edge);
+    engine.draw(deviates, 3);
+    for (int c = 0; c < 3; ++c) {
+        bool boundary = (d >> c & 1) == 0 && (lower[c] == 0 || lower[c] + 1 == grid.vertices[c]);
+        m[c] = 0.5 * (a[c] + b[c]) + (boundary ? 0.0 : random_disturb_num(a[c], b[c], deviates[c], engine.scale));
+    }
+}
+
+// Cell layers layer0 .. layer1-1 into partition: the vertices of these
+// layers (and of the top layer for the last partition), the midside nodes of
+// the edges starting at them, and the elements of the cells. Every midside
+// node is computed once, into a table indexed like the edges (direction,
+// then lower vertex), and the elements look their nodes up there.
+template <typename Traits>
+void generatePartition(const MeshGrid& grid, std::uint64_t layer0, std::uint64_t layer1, MeshPartition& partition)
+{
+    using Pattern = CellPattern<Traits::Linear>;
+    std::uint64_t firstCell = layer0 * grid.cellsPerLayer;
+    std::size_t numCells = static_cast<std::size_t>((layer1 - layer0) * grid.cellsPerLayer);
+    std::size_t numElements = numCells * Pattern::Elements;
+    INSTRUMENT_TIMER(Generate);
+    INSTRUMENT_COUNT(Elements, numElements);
+
+    // coordinates of the vertex layers layer0 .. layer1, the top one shared
+    // with the next partition
+    std::uint64_t firstVertex = layer0 * grid.verticesPerLayer;
+    std::size_t cached = static_cast<std::size_t>((layer1 - layer0 + 1) * grid.verticesPerLayer);
+    std::size_t owned = layer1 == grid.cells[grid.slabAxis] ? cached : cached - static_cast<std::size_t>(grid.verticesPerLayer);
+    std::vector<double> vertexXyz(3 * cached);
+    {
+        INSTRUMENT_TIMER(Corners);
+        for (std::size_t l = 0; l < cached; ++l) {
+            vertexCoordinates(grid, firstVertex + l, &vertexXyz[3 * l]);
+        }
+    }
+    partition.nodeIds.clear();
+    partition.nodeX.clear();
+    partition.nodeY.clear();
+    partition.nodeZ.clear();
+    for (std::size_t l = 0; l < owned; ++l) {
+        partition.nodeIds.push_back(firstVertex + l + 1);
+        partition.nodeX.push_back(vertexXyz[3 * l]);
+        partition.nodeY.push_back(vertexXyz[3 * l + 1]);
+        partition.nodeZ.push_back(vertexXyz[3 * l + 2]);
+    }
+
+    // midside nodes of the edges starting at the cached vertices; those of the
+    // top layer that stay in it belong to the next partition but are used here
+    std::size_t slot[8] = {};
+    std::vector<double> midsideXyz;
+    if constexpr (Traits::Midside > 0) {
+        INSTRUMENT_TIMER(Midside);
+        std::size_t numSlots = 0;
+        for (int d = 1; d < 8; ++d) {
+            if (grid.directions & (1u << d)) {
+                slot[d] = numSlots++;
+            }
+        }
+        midsideXyz.resize(3 * numSlots * cached);
+        PerturbationEngine engine(grid.seed);
+        for (int d = 1; d < 8; ++d) {
+            if (!(grid.directions & (1u << d))) {
+                continue;
+            }
+            std::size_t used = (d >> grid.slabAxis & 1) != 0 ? owned : cached;
+            for (std::size_t l = 0; l < used; ++l) {
+                std::uint64_t lower[3];
+                vertexIndices(grid, firstVertex + l, lower);
+                if (lower[0] + (d & 1) >= grid.vertices[0] || lower[1] + (d >> 1 & 1) >= grid.vertices[1] ||
+                    lower[2] + (d >> 2 & 1) >= grid.vertices[2]) {
+                    continue;
+                }
+                std::uint64_t edge = edgeIndex(grid, lower, d);
+                double* m = &midsideXyz[3 * (slot[d] * cached + l)];
+                midsideCoordinates(grid, lower, d, edge, &vertexXyz[3 * l], &vertexXyz[3 * (l + grid.cornerOffset[d])], engine, m);
+                if (l >= owned) {
+                    continue;
+                }
+                partition.nodeIds.push_back(grid.numVertices + edge + 1);
+                partition.nodeX.push_back(m[0]);
+                partition.nodeY.push_back(m[1]);
+                partition.nodeZ.push_back(m[2]);
+            }
+        }
+    }
+    INSTRUMENT_COUNT(Nodes, partition.nodeIds.size());
+
+    partition.firstElement = firstCell * Pattern::Elements;
+    {
+        INSTRUMENT_TIMER(Allocate);
+        partition.elements.resize(numElements);
+        partition.connectivity.resize(numElements * Traits::Nodes);
+    }
+    for (std::size_t c = 0; c < numCells; ++c) {
+        std::uint64_t cell[3];
+        std::uint64_t index = firstCell + c;
+        cell[0] = index % grid.cells[0];
+        cell[1] = index / grid.cells[0] % grid.cells[1];
+        cell[2] = index / (grid.cells[0] * grid.cells[1]);
+        std::size_t l0 = static_cast<std::size_t>(cell[0] + grid.vertices[0] * (cell[1] + grid.vertices[1] * cell[2]) - firstVertex);
+        for (int e = 0; e < Pattern::Elements; ++e) {
+            std::size_t elm = c * Pattern::Elements + static_cast<std::size_t>(e);
+            std::uint64_t* ids = &partition.connectivity[elm * Traits::Nodes];
+            for (int n = 0; n < Traits::Corners; ++n) {
+                std::size_t l = l0 + static_cast<std::size_t>(grid.cornerOffset[Pattern::Corners[e][n]]);
+                partition.elements.setNode(elm, n, vertexXyz[3 * l], vertexXyz[3 * l + 1], vertexXyz[3 * l + 2]);
+                ids[n] = firstVertex + l + 1;
+            }
+            if constexpr (Traits::Midside > 0) {
+                for (int k = 0; k < Traits::Midside; ++k) {
+                    int ca = Pattern::Corners[e][Traits::Edges[k][0]];
+                    int cb = Pattern::Corners[e][Traits::Edges[k][1]];
+                    int d = ca ^ cb;
+                    int low = ca & cb;
+                    std::uint64_t lower[3] = { cell[0] + (low & 1), cell[1] + (low >> 1 & 1), cell[2] + (low >> 2 & 1) };
+                    std::size_t la = l0 + static_cast<std::size_t>(grid.cornerOffset[low]);
+                    const double* m = &midsideXyz[3 * (slot[d] * cached + la)];
+                    partition.elements.setNode(elm, Traits::Corners + k, m[0], m[1], m[2]);
+                    ids[Traits::Corners + k] = grid.numVertices + edgeIndex(grid, lower, d) + 1;
+                }
+            }
+        }
+    }
+}
+
+template <typename Traits>
+bool streamPartitions(const MeshOptions& options, ThreadPool& pool, std::size_t partitionElements,
+                      std::size_t queueDepth, const MeshSink& sink)
+{
+    using Pattern = CellPattern<Traits::Linear>;
+    using PartitionPtr = std::unique_ptr<MeshPartition>;
+
+    MeshGrid grid = makeGrid<Traits>(options);
+    std::uint64_t layers = grid.cells[grid.slabAxis];
+    std::uint64_t layerElements = grid.cellsPerLayer * Pattern::Elements;
+    std::uint64_t layersPerPartition = layerElements > 0 && partitionElements > layerElements ? partitionElements / layerElements : 1;
+    std::uint64_t numPartitions = (layers + layersPerPartition - 1) / layersPerPartition;
+
+    try {
+        // one partition per thread; the partitions are independent
+        return streamPipeline<MeshPartition>(
+            numPartitions, pool.size(), queueDepth, [] { return PartitionPtr(new MeshPartition(Traits::Type)); },
+            [&](std::vector<PartitionPtr>& partitions, std::uint64_t p, std::size_t n) {
+                pool.parallelFor(n, 1, [&](unsigned, std::size_t begin, std::size_t end) {
+                    for (std::size_t k = begin; k < end; ++k) {
+                        std::uint64_t layer0 = (p + k) * layersPerPartition;
+                        std::uint64_t layer1 = layer0 + layersPerPartition < layers ? layer0 + layersPerPartition : layers;
+                        generatePartition<Traits>(grid, layer0, layer1, *partitions[k]);
+                    }
+                });
+            },
+            sink);
+    }
+    catch (const std::bad_alloc& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+}
+
+} // namespace
+
+bool meshSupported(ElementType type)
+{
+    return withElementTraits(type, [](auto traits) { return CellPattern<decltype(traits)::Linear>::Elements > 0; });
+}
+
+std::uint64_t meshElementCount(ElementType type, const MeshOptions& options)
+{
+    return withElementTraits(type, [&](auto traits) -> std::uint64_t {
+        using Traits = decltype(traits);
+        if constexpr (CellPattern<Traits::Linear>::Elements > 0) {
+            MeshGrid grid = makeGrid<Traits>(options);
+            return grid.cells[0] * grid.cells[1] * grid.cells[2] * CellPattern<Traits::Linear>::Elements;
+        }
+        else {
+            return 0;
+        }
+    });
+}
+
+std::uint64_t meshNodeCount(ElementType type, const MeshOptions& options)
+{
+    return withElementTraits(type, [&](auto traits) -> std::uint64_t {
+        using Traits = decltype(traits);
+        if constexpr (CellPattern<Traits::Linear>::Elements > 0) {
+            MeshGrid grid = makeGrid<Traits>(options);
+            return grid.numVertices + grid.numEdges;
+        }
+        else {
+            return 0;
+        }
+    });
+}
+
+bool streamMesh(ElementType type, const MeshOptions& options, ThreadPool& pool, std::size_t partitionElements,
+                std::size_t queueDepth, const MeshSink& sink)
+{
+    return withElementTraits(type, [&](auto traits) {
+        using Traits = decltype(traits);
+        if constexpr (CellPattern<Traits::Linear>::Elements > 0) {
+            return streamPartitions<Traits>(options, pool, partitionElements, queueDepth, sink);
+        }
+        else {
+            std::cerr << "No mesh of " << Traits::Name << " elements" << std::endl;
+            return false;
+        }
+    });
+}
@@ -0,0 +1,70 @@
+// Connected random meshes. A structured grid over the bounds box is cut into
+// elements of one type that share their corner and midside nodes: one hexa
+// or quad per cell, two prisms or triangles per cell, or the six tetras of
+// the Kuhn split of the cell. Interior grid vertices are jittered and every
+// grid edge gets a single perturbed midside node, so the mesh is random but
+// conforming. Pyramids cannot fill a box on their own and have no mesh.
+//
+// Every node and element is a pure function of the seed and its grid
+// position, so the mesh is cut into partitions (slabs of cell layers along
+// the last axis) that are generated independently and in parallel, and the
+// result does not depend on the number of threads.
+#ifndef ELEMENT_MESH_H
+#define ELEMENT_MESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "elementBatch.h"
+#include "elementGenerator.h"
+
+struct MeshOptions
+{
+    std::uint64_t cells[3] = { 10, 10, 10 }; // cells per axis; triangles and quads ignore cells[2]
+    double minCoord = 0.0;
+    double maxCoord = 10.0;
+    double jitter = 0.15;                    // fraction of the cell size an interior vertex may move per axis;
+                                             // below 1/6 no corner Jacobian of any element can turn negative
+    std::uint64_t seed = 0;
+};
+
+// false for types that cannot be meshed (pyramids)
+bool meshSupported(ElementType type);
+
+std::uint64_t meshElementCount(ElementType type, const MeshOptions& options);
+
+// Distinct nodes: the grid vertices and, for quadratic types, one midside
+// node per grid edge used by the elements
+std::uint64_t meshNodeCount(ElementType type, const MeshOptions& options);
+
+// One slab of a mesh. Node ids are global and start at 1: vertex ids first,
+// then midside ids. A node belongs to the partition that contains the lower
+// end of its grid edge, so every node is in exactly one partition while
+// elements also refer to nodes of the next partition.
+struct MeshPartition
+{
+    explicit MeshPartition(ElementType type) : elements(type) {}
+
+    std::uint64_t firstElement = 0;          // mesh index of the first element (element id = index + 1)
+    std::vector<std::uint64_t> nodeIds;      // nodes of this partition
+    std::vector<double> nodeX;
+    std::vector<double> nodeY;
+    std::vector<double> nodeZ;
+    ElementBatch elements;                   // node coordinates of every element, as in a run
+    std::vector<std::uint64_t> connectivity; // node ids, nodesPerElement per element
+};
+
+// Receives the partitions of a mesh in order; returning false stops the mesh
+using MeshSink = std::function<bool(const MeshPartition& partition)>;
+
+// Generate the mesh in partitions of about partitionElements elements, one
+// partition per pool thread at a time, and hand them to sink on a separate
+// writer thread. At most queueDepth + pool.size() + 1 partitions exist at any
+// time; they are recycled rather than reallocated. false if the type has no
+// mesh, sink failed or memory ran out.
+bool streamMesh(ElementType type, const MeshOptions& options, ThreadPool& pool, std::size_t partitionElements,
+                std::size_t queueDepth, const MeshSink& sink);
+
+#endif
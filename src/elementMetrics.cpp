@@ -0,0 +1,399 @@
+#include "elementMetrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+
+constexpr int TileSize = 32;
+constexpr int MaxCorners = 8;
+constexpr double Pi = 3.14159265358979323846;
+// Divisors are clamped to this instead of tested, as a branch or select on a
+// comparison keeps GCC from vectorising the loop. A zero divisor always comes
+// with a zero numerator, so the degenerate cases still give 0.
+constexpr double Tiny = std::numeric_limits<double>::min();
+
+// Corner coordinates of TileSize elements, corner-major so the element index
+// is the contiguous innermost dimension of every kernel loop
+struct Tile
+{
+    double x[MaxCorners][TileSize];
+    double y[MaxCorners][TileSize];
+    double z[MaxCorners][TileSize];
+};
+
+// Rows of one corner in a tile. The kernels take these out of the corner
+// loops, so the element loops see plain unit-stride arrays.
+struct CornerRows
+{
+    const double* x;
+    const double* y;
+    const double* z;
+};
+
+inline CornerRows cornerRows(const Tile& t, int c)
+{
+    return { t.x[c], t.y[c], t.z[c] };
+}
+
+// Metric tables of each shape on top of its corners and edges from
+// elementTopology.h. JacobianCorners lists (corner, a, b, c):
+// the edges corner->a, corner->b, corner->c form a right-handed frame for a
+// positively oriented element (c is unused in 2D). Faces are oriented
+// outwards. JacobianScale maps the ideal shape's corner value to 1.
+struct TriangleShape : TriangleTopology
+{
+    static constexpr int NumJacobianCorners = 3;
+    static constexpr int JacobianCorners[NumJacobianCorners][4] = { {0, 1, 2, -1}, {1, 2, 0, -1}, {2, 0, 1, -1} };
+    static constexpr double JacobianScale = 1.1547005383792515; // 2 / sqrt(3)
+    static constexpr int NumTriFaces = 1;
+    static constexpr int TriFaces[1][3] = { {0, 1, 2} };
+    static constexpr int NumQuadFaces = 0;
+    static constexpr int QuadFaces[1][4] = { {0, 0, 0, 0} };
+};
+
+struct QuadShape : QuadTopology
+{
+    static constexpr int NumJacobianCorners = 4;
+    static constexpr int JacobianCorners[NumJacobianCorners][4] = { {0, 1, 3, -1}, {1, 2, 0, -1}, {2, 3, 1, -1}, {3, 0, 2, -1} };
+    static constexpr double JacobianScale = 1.0;
+    static constexpr int NumTriFaces = 0;
+    static constexpr int TriFaces[1][3] = { {0, 0, 0} };
+    static constexpr int NumQuadFaces = 1;
+    static constexpr int QuadFaces[1][4] = { {0, 1, 2, 3} };
+};
+
+struct TetraShape : TetraTopology
+{
+    static constexpr int NumJacobianCorners = 4;
+    static constexpr int JacobianCorners[NumJacobianCorners][4] = { {0, 1, 2, 3}, {1, 2, 0, 3}, {2, 0, 1, 3}, {3, 2, 1, 0} };
+    static constexpr double JacobianScale = 1.4142135623730951; // sqrt(2)
+    static constexpr int NumTriFaces = 4;
+    static constexpr int TriFaces[NumTriFaces][3] = { {0, 2, 1}, {0, 1, 3}, {1, 2, 3}, {2, 0, 3} };
+    static constexpr int NumQuadFaces = 0;
+    static constexpr int QuadFaces[1][4] = { {0, 0, 0, 0} };
+};
+
+struct HexaShape : HexaTopology
+{
+    static constexpr int NumJacobianCorners = 8;
+    static constexpr int JacobianCorners[NumJacobianCorners][4] = { {0, 1, 3, 4}, {1, 2, 0, 5}, {2, 3, 1, 6}, {3, 0, 2, 7},
+                                                                    {4, 7, 5, 0}, {5, 4, 6, 1}, {6, 5, 7, 2}, {7, 6, 4, 3} };
+    static constexpr double JacobianScale = 1.0;
+    static constexpr int NumTriFaces = 0;
+    static constexpr int TriFaces[1][3] = { {0, 0, 0} };
+    static constexpr int NumQuadFaces = 6;
+    static constexpr int QuadFaces[NumQuadFaces][4] = { {0, 3, 2, 1}, {4, 5, 6, 7}, {0, 1, 5, 4},
+                                                        {1, 2, 6, 5}, {2, 3, 7, 6}, {3, 0, 4, 7} };
+};
+
+// The apex has four edges and no unique frame; inversion of the apex shows
+// up at the base corners
+struct PyramidShape : PyramidTopology
+{
+    static constexpr int NumJacobianCorners = 4;
+    static constexpr int JacobianCorners[NumJacobianCorners][4] = { {0, 1, 3, 4}, {1, 2, 0, 4}, {2, 3, 1, 4}, {3, 0, 2, 4} };
+    static constexpr double JacobianScale = 1.4142135623730951; // sqrt(2)
+    static constexpr int NumTriFaces = 4;
+    static constexpr int TriFaces[NumTriFaces][3] = { {0, 1, 4}, {1, 2, 4}, {2, 3, 4}, {3, 0, 4} };
+    static constexpr int NumQuadFaces = 1;
+    static constexpr int QuadFaces[1][4] = { {0, 3, 2, 1} };
+};
+
+struct PrismShape : PrismTopology
+{
+    static constexpr int NumJacobianCorners = 6;
+    static constexpr int JacobianCorners[NumJacobianCorners][4] = { {0, 1, 2, 3}, {1, 2, 0, 4}, {2, 0, 1, 5},
+                                                                    {3, 5, 4, 0}, {4, 3, 5, 1}, {5, 4, 3, 2} };
+    static constexpr double JacobianScale = 1.1547005383792515; // 2 / sqrt(3)
+    static constexpr int NumTriFaces = 2;
+    static constexpr int TriFaces[NumTriFaces][3] = { {0, 2, 1}, {3, 4, 5} };
+    static constexpr int NumQuadFaces = 3;
+    static constexpr int QuadFaces[NumQuadFaces][4] = { {0, 1, 4, 3}, {1, 2, 5, 4}, {2, 0, 3, 5} };
+};
+
+// Cosine of the angle at p between p->a and p->b; 1 (zero angle) if degenerate
+inline double cornerCosine(const CornerRows& p, const CornerRows& a, const CornerRows& b, int l)
+{
+    double ux = a.x[l] - p.x[l], uy = a.y[l] - p.y[l], uz = a.z[l] - p.z[l];
+    double vx = b.x[l] - p.x[l], vy = b.y[l] - p.y[l], vz = b.z[l] - p.z[l];
+    double denom = std::sqrt((ux * ux + uy * uy + uz * uz) * (vx * vx + vy * vy + vz * vz));
+    // the second term is 1 for a degenerate corner and 0 otherwise
+    return (ux * vx + uy * vy + uz * vz) / std::max(denom, Tiny) + std::max(0.0, 1.0 - denom / Tiny);
+}
+
+// Equiangle skew from the smallest / largest angle of faces with ideal angle ideal
+inline double angleSkew(double maxCos, double minCos, double ideal)
+{
+    double smallest = std::acos(std::min(1.0, std::max(-1.0, maxCos)));
+    double largest = std::acos(std::min(1.0, std::max(-1.0, minCos)));
+    return std::max((largest - ideal) / (Pi - ideal), (ideal - smallest) / ideal);
+}
+
+template <typename Shape>
+void qualityTile(const Tile& t, int n, std::size_t first, QualityMetrics& q)
+{
+    // edge lengths
+    double shortest[TileSize], longest[TileSize];
+    for (int l = 0; l < TileSize; ++l)
+    {
+        shortest[l] = std::numeric_limits<double>::infinity();
+        longest[l] = 0.0;
+    }
+    for (int e = 0; e < Shape::NumEdges; ++e)
+    {
+        const CornerRows a = cornerRows(t, Shape::Edges[e][0]);
+        const CornerRows b = cornerRows(t, Shape::Edges[e][1]);
+        double len[TileSize];
+        for (int l = 0; l < TileSize; ++l)
+        {
+            double dx = b.x[l] - a.x[l], dy = b.y[l] - a.y[l], dz = b.z[l] - a.z[l];
+            len[l] = std::sqrt(dx * dx + dy * dy + dz * dz);
+        }
+        for (int l = 0; l < TileSize; ++l)
+        {
+            shortest[l] = std::min(shortest[l], len[l]);
+            longest[l] = std::max(longest[l], len[l]);
+        }
+    }
+
+    // scaled Jacobian, and the size that falls out of the same cross products
+    double jacobian[TileSize], size[TileSize];
+    for (int l = 0; l < TileSize; ++l)
+    {
+        jacobian[l] = 1.0;
+        size[l] = 0.0;
+    }
+    if constexpr (Shape::Dim == 2)
+    {
+        // reference normal: the cross product of the diagonals of a quad,
+        // the corner cross product of a triangle (area = half its length)
+        double nx[TileSize], ny[TileSize], nz[TileSize];
+        const CornerRows o0 = cornerRows(t, 0);
+        const CornerRows d0 = cornerRows(t, Shape::NumQuadFaces > 0 ? 2 : 1);
+        const CornerRows d1 = cornerRows(t, Shape::NumQuadFaces > 0 ? 3 : 2);
+        const CornerRows o1 = cornerRows(t, Shape::NumQuadFaces > 0 ? 1 : 0);
+        for (int l = 0; l < TileSize; ++l)
+        {
+            double ux = d0.x[l] - o0.x[l], uy = d0.y[l] - o0.y[l], uz = d0.z[l] - o0.z[l];
+            double vx = d1.x[l] - o1.x[l], vy = d1.y[l] - o1.y[l], vz = d1.z[l] - o1.z[l];
+            nx[l] = uy * vz - uz * vy;
+            ny[l] = uz * vx - ux * vz;
+            nz[l] = ux * vy - uy * vx;
+            size[l] = 0.5 * std::sqrt(nx[l] * nx[l] + ny[l] * ny[l] + nz[l] * nz[l]);
+        }
+        for (int c = 0; c < Shape::NumJacobianCorners; ++c)
+        {
+            const CornerRows p = cornerRows(t, Shape::JacobianCorners[c][0]);
+            const CornerRows a = cornerRows(t, Shape::JacobianCorners[c][1]);
+            const CornerRows b = cornerRows(t, Shape::JacobianCorners[c][2]);
+            for (int l = 0; l < TileSize; ++l)
+            {
+                double ux = a.x[l] - p.x[l], uy = a.y[l] - p.y[l], uz = a.z[l] - p.z[l];
+                double vx = b.x[l] - p.x[l], vy = b.y[l] - p.y[l], vz = b.z[l] - p.z[l];
+                double cx = uy * vz - uz * vy, cy = uz * vx - ux * vz, cz = ux * vy - uy * vx;
+                double lengths = std::sqrt((ux * ux + uy * uy + uz * uz) * (vx * vx + vy * vy + vz * vz) *
+                                           (nx[l] * nx[l] + ny[l] * ny[l] + nz[l] * nz[l]));
+                double value = Shape::JacobianScale * (cx * nx[l] + cy * ny[l] + cz * nz[l]) / std::max(lengths, Tiny);
+                jacobian[l] = std::min(jacobian[l], value);
+            }
+        }
+    }
+    else
+    {
+        for (int c = 0; c < Shape::NumJacobianCorners; ++c)
+        {
+            const CornerRows p = cornerRows(t, Shape::JacobianCorners[c][0]);
+            const CornerRows a = cornerRows(t, Shape::JacobianCorners[c][1]);
+            const CornerRows b = cornerRows(t, Shape::JacobianCorners[c][2]);
+            const CornerRows d = cornerRows(t, Shape::JacobianCorners[c][3]);
+            for (int l = 0; l < TileSize; ++l)
+            {
+                double ux = a.x[l] - p.x[l], uy = a.y[l] - p.y[l], uz = a.z[l] - p.z[l];
+                double vx = b.x[l] - p.x[l], vy = b.y[l] - p.y[l], vz = b.z[l] - p.z[l];
+                double wx = d.x[l] - p.x[l], wy = d.y[l] - p.y[l], wz = d.z[l] - p.z[l];
+                double det = ux * (vy * wz - vz * wy) - uy * (vx * wz - vz * wx) + uz * (vx * wy - vy * wx);
+                double lengths = std::sqrt((ux * ux + uy * uy + uz * uz) * (vx * vx + vy * vy + vz * vz) *
+                                           (wx * wx + wy * wy + wz * wz));
+                double value = Shape::JacobianScale * det / std::max(lengths, Tiny);
+                jacobian[l] = std::min(jacobian[l], value);
+            }
+        }
+
+        // signed volume from the outward faces (divergence theorem), relative
+        // to corner 0. A warped quad face is the mean of its two diagonal
+        // splits, which is exact for the bilinear face of a trilinear element;
+        // one split alone can even make an uninverted element negative.
+        const CornerRows o = cornerRows(t, 0);
+        auto addTriangle = [&](int ia, int ib, int ic, double weight)
+        {
+            const CornerRows a = cornerRows(t, ia);
+            const CornerRows b = cornerRows(t, ib);
+            const CornerRows c = cornerRows(t, ic);
+            for (int l = 0; l < TileSize; ++l)
+            {
+                double ax = a.x[l] - o.x[l], ay = a.y[l] - o.y[l], az = a.z[l] - o.z[l];
+                double bx = b.x[l] - o.x[l], by = b.y[l] - o.y[l], bz = b.z[l] - o.z[l];
+                double cx = c.x[l] - o.x[l], cy = c.y[l] - o.y[l], cz = c.z[l] - o.z[l];
+                size[l] += weight * (ax * (by * cz - bz * cy) - ay * (bx * cz - bz * cx) + az * (bx * cy - by * cx));
+            }
+        };
+        for (int f = 0; f < Shape::NumTriFaces; ++f)
+        {
+            addTriangle(Shape::TriFaces[f][0], Shape::TriFaces[f][1], Shape::TriFaces[f][2], 1.0 / 6.0);
+        }
+        for (int f = 0; f < Shape::NumQuadFaces; ++f)
+        {
+            const int* face = Shape::QuadFaces[f];
+            addTriangle(face[0], face[1], face[2], 1.0 / 12.0);
+            addTriangle(face[0], face[2], face[3], 1.0 / 12.0);
+            addTriangle(face[0], face[1], face[3], 1.0 / 12.0);
+            addTriangle(face[1], face[2], face[3], 1.0 / 12.0);
+        }
+    }
+
+    // face angles, tracked as cosines so only the extremes need an acos
+    double triMaxCos[TileSize], triMinCos[TileSize], quadMaxCos[TileSize], quadMinCos[TileSize];
+    for (int l = 0; l < TileSize; ++l)
+    {
+        triMaxCos[l] = quadMaxCos[l] = -1.0;
+        triMinCos[l] = quadMinCos[l] = 1.0;
+    }
+    for (int f = 0; f < Shape::NumTriFaces; ++f)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            const CornerRows p = cornerRows(t, Shape::TriFaces[f][k]);
+            const CornerRows a = cornerRows(t, Shape::TriFaces[f][(k + 1) % 3]);
+            const CornerRows b = cornerRows(t, Shape::TriFaces[f][(k + 2) % 3]);
+            for (int l = 0; l < TileSize; ++l)
+            {
+                double c = cornerCosine(p, a, b, l);
+                triMaxCos[l] = std::max(triMaxCos[l], c);
+                triMinCos[l] = std::min(triMinCos[l], c);
+            }
+        }
+    }
+    for (int f = 0; f < Shape::NumQuadFaces; ++f)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            const CornerRows p = cornerRows(t, Shape::QuadFaces[f][k]);
+            const CornerRows a = cornerRows(t, Shape::QuadFaces[f][(k + 1) % 4]);
+            const CornerRows b = cornerRows(t, Shape::QuadFaces[f][(k + 3) % 4]);
+            for (int l = 0; l < TileSize; ++l)
+            {
+                double c = cornerCosine(p, a, b, l);
+                quadMaxCos[l] = std::max(quadMaxCos[l], c);
+                quadMinCos[l] = std::min(quadMinCos[l], c);
+            }
+        }
+    }
+
+    for (int l = 0; l < n; ++l)
+    {
+        double skew = 0.0;
+        if (Shape::NumTriFaces > 0)
+        {
+            skew = std::max(skew, angleSkew(triMaxCos[l], triMinCos[l], Pi / 3.0));
+        }
+        if (Shape::NumQuadFaces > 0)
+        {
+            skew = std::max(skew, angleSkew(quadMaxCos[l], quadMinCos[l], Pi / 2.0));
+        }
+        std::size_t i = first + static_cast<std::size_t>(l);
+        q.scaledJacobian[i] = jacobian[l];
+        q.aspectRatio[i] = shortest[l] > 0.0 ? longest[l] / shortest[l] : std::numeric_limits<double>::infinity();
+        q.skew[i] = std::min(1.0, skew);
+        q.size[i] = size[l];
+        q.minEdgeLength[i] = shortest[l];
+    }
+}
+
+template <typename Shape>
+void computeTiles(const ElementBatch& batch, std::size_t begin, std::size_t end, QualityMetrics& quality)
+{
+    Tile tile;
+    for (std::size_t first = begin; first < end; first += TileSize)
+    {
+        int n = end - first < static_cast<std::size_t>(TileSize) ? static_cast<int>(end - first) : TileSize;
+        // unused lanes repeat the last element so the kernels run full tiles
+        for (int l = 0; l < TileSize; ++l)
+        {
+            std::size_t elm = first + static_cast<std::size_t>(l < n ? l : n - 1);
+            for (int c = 0; c < Shape::Corners; ++c)
+            {
+                tile.x[c][l] = batch.x(elm, c);
+                tile.y[c][l] = batch.y(elm, c);
+                tile.z[c][l] = batch.z(elm, c);
+            }
+        }
+        qualityTile<Shape>(tile, n, first, quality);
+    }
+}
+
+} // namespace
+
+void computeQuality(const ElementBatch& batch, std::size_t begin, std::size_t end, QualityMetrics& quality)
+{
+    // quadratic elements are measured on their corners
+    switch (linearType(batch.type))
+    {
+        case ElementType::LINEAR_TRIANGLE:
+            computeTiles<TriangleShape>(batch, begin, end, quality);
+            break;
+        case ElementType::LINEAR_QUAD:
+            computeTiles<QuadShape>(batch, begin, end, quality);
+            break;
+        case ElementType::LINEAR_TETRA:
+            computeTiles<TetraShape>(batch, begin, end, quality);
+            break;
+        case ElementType::LINEAR_HEXA:
+            computeTiles<HexaShape>(batch, begin, end, quality);
+            break;
+        case ElementType::LINEAR_PYRAMID:
+            computeTiles<PyramidShape>(batch, begin, end, quality);
+            break;
+        case ElementType::LINEAR_PRISM:
+            computeTiles<PrismShape>(batch, begin, end, quality);
+            break;
+        default:
+            break;
+    }
+}
+
+void computeQuality(const ElementBatch& batch, QualityMetrics& quality)
+{
+    quality.resize(batch.size());
+    computeQuality(batch, 0, batch.size(), quality);
+}
+
+void QualitySummary::add(const QualityMetrics& quality, std::size_t count)
+{
+    const std::vector<double>* metrics[NumMetrics] = { &quality.scaledJacobian, &quality.aspectRatio, &quality.skew,
+                                                       &quality.size, &quality.minEdgeLength };
+    for (int m = 0; m < NumMetrics; ++m)
+    {
+        const std::vector<double>& values = *metrics[m];
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            double v = values[i];
+            if (elements == 0 && i == 0)
+            {
+                minimum[m] = maximum[m] = v;
+            }
+            minimum[m] = std::min(minimum[m], v);
+            maximum[m] = std::max(maximum[m], v);
+            sum[m] += v;
+        }
+    }
+    elements += count;
+}
+
+const char* QualitySummary::name(int metric)
+{
+    static const char* const names[NumMetrics] = { "scaled Jacobian", "aspect ratio", "skew", "size", "min edge" };
+    return names[metric];
+}
@@ -0,0 +1,70 @@
+// Element quality metrics, computed from the corner nodes of each element
+#ifndef ELEMENT_METRICS_H
+#define ELEMENT_METRICS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "elementBatch.h"
+
+// Quality of a range of elements, one array per metric (index = element)
+//   scaledJacobian  minimum over the corners of the Jacobian divided by the
+//                   lengths of the corner's edges, scaled so the ideal shape
+//                   gives 1 and capped at 1; negative for inverted corners.
+//                   Triangles have no orientation and are never negative.
+//   aspectRatio     longest / shortest edge
+//   skew            equiangle skew of the faces, 0 for ideal angles (60 deg in
+//                   triangles, 90 deg in quads) up to 1 for degenerate ones
+//   size            area of 2D elements, signed volume of 3D elements
+//   minEdgeLength   shortest edge
+struct QualityMetrics
+{
+    std::vector<double> scaledJacobian;
+    std::vector<double> aspectRatio;
+    std::vector<double> skew;
+    std::vector<double> size;
+    std::vector<double> minEdgeLength;
+
+    void resize(std::size_t numElements)
+    {
+        scaledJacobian.resize(numElements);
+        aspectRatio.resize(numElements);
+        skew.resize(numElements);
+        size.resize(numElements);
+        minEdgeLength.resize(numElements);
+    }
+};
+
+// Quality of elements begin .. end-1 of batch into entries begin .. end-1 of
+// quality, which must already hold at least end entries. Elements are
+// processed in tiles with the element index innermost, so the edge,
+// Jacobian, volume and face angle kernels vectorise; GCC needs -O3
+// -fno-math-errno for the loops that take a sqrt (check -fopt-info-vec).
+// Finishing a tile (acos of the extreme angles) stays scalar.
+void computeQuality(const ElementBatch& batch, std::size_t begin, std::size_t end, QualityMetrics& quality);
+
+// Resize quality to batch.size() and compute every element
+void computeQuality(const ElementBatch& batch, QualityMetrics& quality);
+
+// Running min / mean / max of each metric over any number of batches
+class QualitySummary
+{
+public:
+    void add(const QualityMetrics& quality, std::size_t count);
+
+    std::size_t count() const { return elements; }
+    double min(int metric) const { return minimum[metric]; }
+    double max(int metric) const { return maximum[metric]; }
+    double mean(int metric) const { return elements > 0 ? sum[metric] / static_cast<double>(elements) : 0.0; }
+
+    static constexpr int NumMetrics = 5;
+    static const char* name(int metric);
+
+private:
+    std::size_t elements = 0;
+    double minimum[NumMetrics] = {};
+    double maximum[NumMetrics] = {};
+    double sum[NumMetrics] = {};
+};
+
+#endif
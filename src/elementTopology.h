@@ -0,0 +1,242 @@
+// Element types and their topology as compile-time tables. Code that loops
+// over the nodes or edges of an element is written once as a template on
+// ElementTraits<Type> and dispatched with withElementTraits, so the loops
+// have constant trip counts and unroll; the only runtime switch is the one
+// that picks the instantiation for a batch.
+#ifndef ELEMENT_TOPOLOGY_H
+#define ELEMENT_TOPOLOGY_H
+
+// Define Elements Type. Values are stored in binary element files, so new
+// types go at the end.
+enum class ElementType
+{
+    LINEAR_TRIANGLE,
+    LINEAR_QUAD,
+    LINEAR_TETRA,
+    LINEAR_HEXA,
+    LINEAR_PYRAMID,
+    LINEAR_PRISM,
+    QUADRATIC_TRIANGLE,
+    QUADRATIC_QUAD,
+    QUADRATIC_TETRA,
+    QUADRATIC_HEX,
+    QUADRATIC_PYRAMID,
+    QUADRATIC_PRISM
+};
+
+constexpr int NumElementTypes = 12;
+
+// Corner topology of each shape. Edges are listed in Nastran midside order:
+// midside node k of the quadratic element (numbered after the corners) sits
+// on edge Edges[k].
+struct TriangleTopology
+{
+    static constexpr int Corners = 3;
+    static constexpr int Dim = 2;
+    static constexpr int NumEdges = 3;
+    static constexpr int Edges[NumEdges][2] = { {0, 1}, {1, 2}, {2, 0} };
+};
+
+struct QuadTopology
+{
+    static constexpr int Corners = 4;
+    static constexpr int Dim = 2;
+    static constexpr int NumEdges = 4;
+    static constexpr int Edges[NumEdges][2] = { {0, 1}, {1, 2}, {2, 3}, {3, 0} };
+};
+
+struct TetraTopology
+{
+    static constexpr int Corners = 4;
+    static constexpr int Dim = 3;
+    static constexpr int NumEdges = 6;
+    static constexpr int Edges[NumEdges][2] = { {0, 1}, {1, 2}, {2, 0}, {0, 3}, {1, 3}, {2, 3} };
+};
+
+struct HexaTopology
+{
+    static constexpr int Corners = 8;
+    static constexpr int Dim = 3;
+    static constexpr int NumEdges = 12;
+    static constexpr int Edges[NumEdges][2] = { {0, 1}, {1, 2}, {2, 3}, {3, 0}, {0, 4}, {1, 5},
+                                                {2, 6}, {3, 7}, {4, 5}, {5, 6}, {6, 7}, {7, 4} };
+};
+
+struct PyramidTopology
+{
+    static constexpr int Corners = 5;
+    static constexpr int Dim = 3;
+    static constexpr int NumEdges = 8;
+    static constexpr int Edges[NumEdges][2] = { {0, 1}, {1, 2}, {2, 3}, {3, 0}, {0, 4}, {1, 4}, {2, 4}, {3, 4} };
+};
+
+struct PrismTopology
+{
+    static constexpr int Corners = 6;
+    static constexpr int Dim = 3;
+    static constexpr int NumEdges = 9;
+    static constexpr int Edges[NumEdges][2] = { {0, 1}, {1, 2}, {2, 0}, {0, 3}, {1, 4}, {2, 5}, {3, 4}, {4, 5}, {5, 3} };
+};
+
+// A linear element has only its corners, a quadratic one adds a midside
+// node on every edge
+template <typename Topology, ElementType LinearType, bool Quadratic>
+struct ElementTopology : Topology
+{
+    static constexpr ElementType Linear = LinearType;
+    static constexpr int Midside = Quadratic ? Topology::NumEdges : 0;
+    static constexpr int Nodes = Topology::Corners + Midside;
+};
+
+template <ElementType Type>
+struct ElementTraits;
+
+template <>
+struct ElementTraits<ElementType::LINEAR_TRIANGLE> : ElementTopology<TriangleTopology, ElementType::LINEAR_TRIANGLE, false>
+{
+    static constexpr ElementType Type = ElementType::LINEAR_TRIANGLE;
+    static constexpr const char* Name = "LINEAR_TRIANGLE";
+    static constexpr const char* NastranCard = "CTRIA3";
+};
+
+template <>
+struct ElementTraits<ElementType::LINEAR_QUAD> : ElementTopology<QuadTopology, ElementType::LINEAR_QUAD, false>
+{
+    static constexpr ElementType Type = ElementType::LINEAR_QUAD;
+    static constexpr const char* Name = "LINEAR_QUAD";
+    static constexpr const char* NastranCard = "CQUAD4";
+};
+
+template <>
+struct ElementTraits<ElementType::LINEAR_TETRA> : ElementTopology<TetraTopology, ElementType::LINEAR_TETRA, false>
+{
+    static constexpr ElementType Type = ElementType::LINEAR_TETRA;
+    static constexpr const char* Name = "LINEAR_TETRA";
+    static constexpr const char* NastranCard = "CTETRA";
+};
+
+template <>
+struct ElementTraits<ElementType::LINEAR_HEXA> : ElementTopology<HexaTopology, ElementType::LINEAR_HEXA, false>
+{
+    static constexpr ElementType Type = ElementType::LINEAR_HEXA;
+    static constexpr const char* Name = "LINEAR_HEXA";
+    static constexpr const char* NastranCard = "CHEXA";
+};
+
+template <>
+struct ElementTraits<ElementType::LINEAR_PYRAMID> : ElementTopology<PyramidTopology, ElementType::LINEAR_PYRAMID, false>
+{
+    static constexpr ElementType Type = ElementType::LINEAR_PYRAMID;
+    static constexpr const char* Name = "LINEAR_PYRAMID";
+    static constexpr const char* NastranCard = "CPYRA";
+};
+
+template <>
+struct ElementTraits<ElementType::LINEAR_PRISM> : ElementTopology<PrismTopology, ElementType::LINEAR_PRISM, false>
+{
+    static constexpr ElementType Type = ElementType::LINEAR_PRISM;
+    static constexpr const char* Name = "LINEAR_PRISM";
+    static constexpr const char* NastranCard = "CPENTA";
+};
+
+template <>
+struct ElementTraits<ElementType::QUADRATIC_TRIANGLE> : ElementTopology<TriangleTopology, ElementType::LINEAR_TRIANGLE, true>
+{
+    static constexpr ElementType Type = ElementType::QUADRATIC_TRIANGLE;
+    static constexpr const char* Name = "QUADRATIC_TRIANGLE";
+    static constexpr const char* NastranCard = "CTRIA6";
+};
+
+template <>
+struct ElementTraits<ElementType::QUADRATIC_QUAD> : ElementTopology<QuadTopology, ElementType::LINEAR_QUAD, true>
+{
+    static constexpr ElementType Type = ElementType::QUADRATIC_QUAD;
+    static constexpr const char* Name = "QUADRATIC_QUAD";
+    static constexpr const char* NastranCard = "CQUAD8";
+};
+
+template <>
+struct ElementTraits<ElementType::QUADRATIC_TETRA> : ElementTopology<TetraTopology, ElementType::LINEAR_TETRA, true>
+{
+    static constexpr ElementType Type = ElementType::QUADRATIC_TETRA;
+    static constexpr const char* Name = "QUADRATIC_TETRA";
+    static constexpr const char* NastranCard = "CTETRA";
+};
+
+template <>
+struct ElementTraits<ElementType::QUADRATIC_HEX> : ElementTopology<HexaTopology, ElementType::LINEAR_HEXA, true>
+{
+    static constexpr ElementType Type = ElementType::QUADRATIC_HEX;
+    static constexpr const char* Name = "QUADRATIC_HEX";
+    static constexpr const char* NastranCard = "CHEXA";
+};
+
+template <>
+struct ElementTraits<ElementType::QUADRATIC_PYRAMID> : ElementTopology<PyramidTopology, ElementType::LINEAR_PYRAMID, true>
+{
+    static constexpr ElementType Type = ElementType::QUADRATIC_PYRAMID;
+    static constexpr const char* Name = "QUADRATIC_PYRAMID";
+    static constexpr const char* NastranCard = "CPYRA";
+};
+
+template <>
+struct ElementTraits<ElementType::QUADRATIC_PRISM> : ElementTopology<PrismTopology, ElementType::LINEAR_PRISM, true>
+{
+    static constexpr ElementType Type = ElementType::QUADRATIC_PRISM;
+    static constexpr const char* Name = "QUADRATIC_PRISM";
+    static constexpr const char* NastranCard = "CPENTA";
+};
+
+// f(ElementTraits<type>()) - the runtime switch in front of per-type code
+template <typename F>
+decltype(auto) withElementTraits(ElementType type, F&& f)
+{
+    switch (type)
+    {
+        case ElementType::LINEAR_TRIANGLE:    return f(ElementTraits<ElementType::LINEAR_TRIANGLE>());
+        case ElementType::LINEAR_QUAD:        return f(ElementTraits<ElementType::LINEAR_QUAD>());
+        case ElementType::LINEAR_TETRA:       return f(ElementTraits<ElementType::LINEAR_TETRA>());
+        case ElementType::LINEAR_HEXA:        return f(ElementTraits<ElementType::LINEAR_HEXA>());
+        case ElementType::LINEAR_PYRAMID:     return f(ElementTraits<ElementType::LINEAR_PYRAMID>());
+        case ElementType::LINEAR_PRISM:       return f(ElementTraits<ElementType::LINEAR_PRISM>());
+        case ElementType::QUADRATIC_TRIANGLE: return f(ElementTraits<ElementType::QUADRATIC_TRIANGLE>());
+        case ElementType::QUADRATIC_QUAD:     return f(ElementTraits<ElementType::QUADRATIC_QUAD>());
+        case ElementType::QUADRATIC_TETRA:    return f(ElementTraits<ElementType::QUADRATIC_TETRA>());
+        case ElementType::QUADRATIC_HEX:      return f(ElementTraits<ElementType::QUADRATIC_HEX>());
+        case ElementType::QUADRATIC_PYRAMID:  return f(ElementTraits<ElementType::QUADRATIC_PYRAMID>());
+        case ElementType::QUADRATIC_PRISM:    return f(ElementTraits<ElementType::QUADRATIC_PRISM>());
+    }
+    // not reached for valid enum values
+    return f(ElementTraits<ElementType::LINEAR_TRIANGLE>());
+}
+
+// Number of nodes (corner + midside) of each element type
+inline int nodesPerElement(ElementType type)
+{
+    return withElementTraits(type, [](auto traits) { return decltype(traits)::Nodes; });
+}
+
+// Number of corner nodes, i.e. the nodes placed by generateNodes
+inline int cornersPerElement(ElementType type)
+{
+    return withElementTraits(type, [](auto traits) { return decltype(traits)::Corners; });
+}
+
+// Linear type with the same corners
+inline ElementType linearType(ElementType type)
+{
+    return withElementTraits(type, [](auto traits) { return decltype(traits)::Linear; });
+}
+
+inline const char* elementTypeName(ElementType type)
+{
+    return withElementTraits(type, [](auto traits) { return decltype(traits)::Name; });
+}
+
+// Nastran element card of each type
+inline const char* nastranCard(ElementType type)
+{
+    return withElementTraits(type, [](auto traits) { return decltype(traits)::NastranCard; });
+}
+
+#endif
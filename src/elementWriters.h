@@ -0,0 +1,434 @@
+// Text writers (Metric.txt, Nastran bulk data) and the binary element file
+// writer. Header-only; every writer buffers in memory and hands the file
+// system large chunks.
+#ifndef ELEMENT_WRITERS_H
+#define ELEMENT_WRITERS_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "elementBatch.h"
+#include "elementBinaryReader.h"
+#include "elementMetrics.h"
+#include "instrumentation.h"
+
+// Text output formatted in memory with std::to_chars and handed to the file
+// system in large chunks instead of one stream insertion per value
+class OutputBuffer
+{
+public:
+    explicit OutputBuffer(std::size_t capacity = std::size_t(1) << 20)
+        : buffer(capacity < 64 ? 64 : capacity)
+    {
+    }
+
+    ~OutputBuffer() { close(); }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    bool open(const std::string& path)
+    {
+        close();
+        INSTRUMENT_TIMER(FileSystem);
+        INSTRUMENT_COUNT(FilesOpened, 1);
+        file = std::fopen(path.c_str(), "wb");
+        failed = file == nullptr;
+        return !failed;
+    }
+
+    // Flush and close; false if any write failed since open()
+    bool close()
+    {
+        if (file != nullptr)
+        {
+            flush();
+            INSTRUMENT_TIMER(FileSystem);
+            if (std::fclose(file) != 0)
+            {
+                failed = true;
+            }
+            file = nullptr;
+        }
+        return !failed;
+    }
+
+    void put(char c)
+    {
+        reserve(1);
+        buffer[used++] = c;
+    }
+
+    void put(const char* text)
+    {
+        for (; *text != '\0'; ++text)
+        {
+            put(*text);
+        }
+    }
+
+    void putInt(std::uint64_t value)
+    {
+        reserve(24);
+        char* begin = buffer.data() + used;
+        used = static_cast<std::size_t>(std::to_chars(begin, begin + 24, value).ptr - buffer.data());
+    }
+
+    // Same text as the default stream formatting (%g, 6 significant digits)
+    void putDouble(double value)
+    {
+        reserve(32);
+        char* begin = buffer.data() + used;
+        used = static_cast<std::size_t>(std::to_chars(begin, begin + 32, value, std::chars_format::general, 6).ptr - buffer.data());
+    }
+
+    // putDouble with a decimal point always present, as Nastran real fields need
+    void putReal(double value)
+    {
+        reserve(32);
+        char* begin = buffer.data() + used;
+        char* end = std::to_chars(begin, begin + 31, value, std::chars_format::general, 6).ptr;
+        char* exponent = end;
+        for (char* c = begin; c != end; ++c)
+        {
+            if (*c == '.' || *c == 'n' || *c == 'i')
+            {
+                exponent = nullptr;
+                break;
+            }
+            if (*c == 'e')
+            {
+                exponent = c;
+                break;
+            }
+        }
+        if (exponent != nullptr)
+        {
+            for (char* c = end; c != exponent; --c)
+            {
+                *c = *(c - 1);
+            }
+            *exponent = '.';
+            ++end;
+        }
+        used = static_cast<std::size_t>(end - buffer.data());
+    }
+
+    std::uint64_t bytesWritten() const { return written + used; }
+
+private:
+    void reserve(std::size_t n)
+    {
+        if (used + n > buffer.size())
+        {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        INSTRUMENT_TIMER(FileSystem);
+        INSTRUMENT_COUNT(BytesWritten, file != nullptr ? used : 0);
+        if (used > 0 && file != nullptr && std::fwrite(buffer.data(), 1, used, file) != used)
+        {
+            failed = true;
+        }
+        written += used;
+        used = 0;
+    }
+
+    std::vector<char> buffer;
+    std::size_t used = 0;
+    std::uint64_t written = 0;
+    std::FILE* file = nullptr;
+    bool failed = false;
+};
+
+// Metric.txt: one line of {x,y,z} node coordinates per element, followed by
+// " sj=.. ar=.. skew=.. size=.. hmin=.." when quality is given
+class MetricWriter
+{
+public:
+    bool open(const std::string& path) { return out.open(path); }
+    bool close() { return out.close(); }
+    std::uint64_t bytesWritten() const { return out.bytesWritten(); }
+
+    void write(const ElementBatch& batch, const QualityMetrics* quality = nullptr)
+    {
+        INSTRUMENT_TIMER(Format);
+        withElementTraits(batch.type, [&](auto traits) { writeElements<decltype(traits)>(batch, quality); });
+    }
+
+private:
+    template <typename Traits>
+    void writeElements(const ElementBatch& batch, const QualityMetrics* quality)
+    {
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            for (int j = 0; j < Traits::Nodes; ++j) {
+                out.put('{');
+                out.putDouble(batch.x(i, j));
+                out.put(',');
+                out.putDouble(batch.y(i, j));
+                out.put(',');
+                out.putDouble(batch.z(i, j));
+                out.put('}');
+            }
+            if (quality != nullptr) {
+                out.put(" sj=");
+                out.putDouble(quality->scaledJacobian[i]);
+                out.put(" ar=");
+                out.putDouble(quality->aspectRatio[i]);
+                out.put(" skew=");
+                out.putDouble(quality->skew[i]);
+                out.put(" size=");
+                out.putDouble(quality->size[i]);
+                out.put(" hmin=");
+                out.putDouble(quality->minEdgeLength[i]);
+            }
+            out.put('\n');
+        }
+    }
+
+    OutputBuffer out;
+};
+
+// Nastran free-field bulk data. Deck puts every element into one
+// RandomElements.nas with GRID ids index * nodesPerElement + j + 1 and element
+// id index + 1 (index = run index); PerElement keeps the RandomElement<index>.nas
+// layout with ids starting at 1 in every file. setIdBase shifts the ids (and
+// per-element file numbers) so several runs can share one deck. Connected
+// meshes write their shared nodes and elements with writeNodes and
+// writeConnectivity instead.
+class NastranWriter
+{
+public:
+    enum class Layout
+    {
+        Deck,
+        PerElement
+    };
+
+    bool open(const std::string& directory, Layout fileLayout)
+    {
+        outDir = directory;
+        layout = fileLayout;
+        if (layout == Layout::PerElement) {
+            return true;
+        }
+        if (!out.open(outDir + "RandomElements.nas")) {
+            return false;
+        }
+        out.put("BEGIN BULK\n");
+        return true;
+    }
+
+    void setIdBase(std::uint64_t firstGridId, std::uint64_t firstElementId)
+    {
+        gridBase = firstGridId;
+        elementBase = firstElementId;
+    }
+
+    std::uint64_t bytesWritten() const { return out.bytesWritten(); }
+
+    bool write(const ElementBatch& batch, std::uint64_t firstIndex)
+    {
+        INSTRUMENT_TIMER(Format);
+        return withElementTraits(batch.type, [&](auto traits) { return writeElements<decltype(traits)>(batch, firstIndex); });
+    }
+
+    // GRID cards of mesh nodes with their own ids (shifted by the grid id
+    // base), each node written once however many elements share it
+    void writeNodes(const std::uint64_t* ids, const double* xs, const double* ys, const double* zs, std::size_t n)
+    {
+        INSTRUMENT_TIMER(Format);
+        for (std::size_t i = 0; i < n; ++i) {
+            putGrid(gridBase + ids[i], xs[i], ys[i], zs[i]);
+        }
+    }
+
+    // Element cards of mesh elements firstIndex .. firstIndex+count-1, node
+    // ids of element i at connectivity[i * nodesPerElement ..]. Deck layout
+    // only; false for per-element files.
+    bool writeConnectivity(ElementType type, std::uint64_t firstIndex, const std::uint64_t* connectivity, std::size_t count)
+    {
+        if (layout != Layout::Deck) {
+            return false;
+        }
+        INSTRUMENT_TIMER(Format);
+        withElementTraits(type, [&](auto traits) {
+            using Traits = decltype(traits);
+            for (std::size_t i = 0; i < count; ++i) {
+                out.put(Traits::NastranCard);
+                out.put(',');
+                out.putInt(elementBase + firstIndex + i + 1);
+                out.put(",1");
+                for (int j = 0; j < Traits::Nodes; ++j) {
+                    out.put(',');
+                    out.putInt(gridBase + connectivity[i * Traits::Nodes + static_cast<std::size_t>(j)]);
+                }
+                out.put('\n');
+            }
+        });
+        return true;
+    }
+
+    bool close()
+    {
+        if (layout == Layout::Deck) {
+            out.put("ENDDATA\n");
+        }
+        return out.close();
+    }
+
+private:
+    template <typename Traits>
+    bool writeElements(const ElementBatch& batch, std::uint64_t firstIndex)
+    {
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            std::uint64_t index = firstIndex + i;
+            if (layout == Layout::Deck) {
+                writeElement<Traits>(batch, i, elementBase + index + 1, gridBase + index * static_cast<std::uint64_t>(Traits::Nodes) + 1);
+                continue;
+            }
+            if (!out.open(outDir + "RandomElement" + std::to_string(elementBase + index) + ".nas")) {
+                return false;
+            }
+            out.put("BEGIN BULK\n");
+            writeElement<Traits>(batch, i, 1, 1);
+            out.put("ENDDATA\n");
+            if (!out.close()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename Traits>
+    void writeElement(const ElementBatch& batch, std::size_t slot, std::uint64_t eid, std::uint64_t firstGrid)
+    {
+        for (int j = 0; j < Traits::Nodes; ++j) {
+            putGrid(firstGrid + static_cast<std::uint64_t>(j), batch.x(slot, j), batch.y(slot, j), batch.z(slot, j));
+        }
+        out.put(Traits::NastranCard);
+        out.put(',');
+        out.putInt(eid);
+        out.put(",1");
+        for (int j = 0; j < Traits::Nodes; ++j) {
+            out.put(',');
+            out.putInt(firstGrid + static_cast<std::uint64_t>(j));
+        }
+        out.put('\n');
+    }
+
+    void putGrid(std::uint64_t id, double x, double y, double z)
+    {
+        out.put("GRID,");
+        out.putInt(id);
+        out.put(",,");
+        out.putReal(x);
+        out.put(',');
+        out.putReal(y);
+        out.put(',');
+        out.putReal(z);
+        out.put('\n');
+    }
+
+    OutputBuffer out;
+    std::string outDir;
+    Layout layout = Layout::Deck;
+    std::uint64_t gridBase = 0;
+    std::uint64_t elementBase = 0;
+};
+
+// Binary element file, see elementBinaryReader.h for the layout. The header
+// is rewritten with the final element count on close().
+class BinaryWriter
+{
+public:
+    BinaryWriter() = default;
+    ~BinaryWriter() { close(); }
+
+    BinaryWriter(const BinaryWriter&) = delete;
+    BinaryWriter& operator=(const BinaryWriter&) = delete;
+
+    bool open(const std::string& path, ElementType type, std::uint64_t seed, std::uint64_t firstIndex,
+              double minCoord, double maxCoord)
+    {
+        close();
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, ElementFileMagic, sizeof(header.magic));
+        header.version = ElementFileVersion;
+        header.elementType = static_cast<std::uint32_t>(type);
+        header.nodesPerElement = static_cast<std::uint32_t>(nodesPerElement(type));
+        header.seed = seed;
+        header.firstIndex = firstIndex;
+        header.minCoord = minCoord;
+        header.maxCoord = maxCoord;
+        INSTRUMENT_TIMER(FileSystem);
+        INSTRUMENT_COUNT(FilesOpened, 1);
+        INSTRUMENT_COUNT(BytesWritten, sizeof(header));
+        file = std::fopen(path.c_str(), "wb");
+        failed = file == nullptr || std::fwrite(&header, sizeof(header), 1, file) != 1;
+        if (!failed) {
+            written += sizeof(header);
+        }
+        return !failed;
+    }
+
+    // Interleave the batch into x, y, z per node and append it in large chunks
+    bool write(const ElementBatch& batch)
+    {
+        INSTRUMENT_TIMER(Format);
+        const std::size_t chunkNodes = 1 << 15;
+        chunk.resize(3 * chunkNodes);
+        const double* xs = batch.xData();
+        const double* ys = batch.yData();
+        const double* zs = batch.zData();
+        for (std::size_t begin = 0; begin < batch.numNodes() && !failed; begin += chunkNodes) {
+            std::size_t n = batch.numNodes() - begin < chunkNodes ? batch.numNodes() - begin : chunkNodes;
+            for (std::size_t k = 0; k < n; ++k) {
+                chunk[3 * k] = xs[begin + k];
+                chunk[3 * k + 1] = ys[begin + k];
+                chunk[3 * k + 2] = zs[begin + k];
+            }
+            INSTRUMENT_TIMER(FileSystem);
+            INSTRUMENT_COUNT(BytesWritten, 3 * n * sizeof(double));
+            failed = std::fwrite(chunk.data(), sizeof(double), 3 * n, file) != 3 * n;
+            written += 3 * n * sizeof(double);
+        }
+        header.count += batch.size();
+        return !failed;
+    }
+
+    bool close()
+    {
+        if (file != nullptr) {
+            INSTRUMENT_TIMER(FileSystem);
+            if (!failed) {
+                failed = std::fseek(file, 0, SEEK_SET) != 0 || std::fwrite(&header, sizeof(header), 1, file) != 1;
+            }
+            if (std::fclose(file) != 0) {
+                failed = true;
+            }
+            file = nullptr;
+        }
+        return !failed;
+    }
+
+    // bytes of every file written by this writer
+    std::uint64_t bytesWritten() const { return written; }
+
+private:
+    ElementFileHeader header;
+    std::vector<double> chunk;
+    std::FILE* file = nullptr;
+    std::uint64_t written = 0;
+    bool failed = false;
+};
+
+#endif
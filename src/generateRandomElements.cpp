@@ -1,402 +1,540 @@
 #include <iostream>
 #include <vector>
-#include <cstdlib>
 #include <ctime>
-#include <fstream>
-#include <random>
 #include <string>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <sstream>
 
-// Define Elements Type
-enum class ElementType
+#include "elementBatch.h"
+#include "elementGenerator.h"
+#include "elementMesh.h"
+#include "elementMetrics.h"
+#include "elementWriters.h"
+#include "instrumentation.h"
+
+// One entry of a batch job: count elements of type from run index first,
+// with their own bounds and seed
+struct JobEntry
 {
-    LINEAR_TRIANGLE,
-    LINEAR_QUAD,
-    LINEAR_TETRA,
-    LINEAR_HEXA,
-    LINEAR_PYRAMID,
-    LINEAR_PRISM,
-    QUADRATIC_TRIANGLE,
-    QUADRATIC_QUAD,
-    QUADRATIC_TETRA,
-    QUADRATIC_HEX
+    ElementType type;
+    std::uint64_t first;
+    std::uint64_t count;
+    double minCoord;
+    double maxCoord;
+    std::uint64_t seed;
 };
 
-// Generate random node coordination
-std::vector<std::vector<double>> generateNodes(int numNodes, double minCoord, double maxCoord)
+// Job description, one entry per line: TYPE COUNT [MIN MAX [SEED]]. Blank
+// lines and lines starting with # are skipped, missing values are taken
+// from defaults. false if the file cannot be read or a line is malformed.
+bool readJobFile(const std::string& path, const JobEntry& defaults, std::vector<JobEntry>& entries)
 {
-    std::vector<std::vector<double>> nodes(numNodes, std::vector<double>(3, 0.0));
-    for (int i = 0; i < numNodes; ++i)
-    {
-        nodes[i][0] = minCoord + static_cast<double>(rand()) / RAND_MAX * (maxCoord - minCoord); // x
-        nodes[i][1] = minCoord + static_cast<double>(rand()) / RAND_MAX * (maxCoord - minCoord); // y
-        nodes[i][2] = minCoord + static_cast<double>(rand()) / RAND_MAX * (maxCoord - minCoord); // z
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot read job file " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+        std::istringstream stream(line);
+        std::vector<std::string> fields;
+        for (std::string field; stream >> field;) {
+            fields.push_back(field);
+        }
+        if (fields.empty() || fields[0][0] == '#') {
+            continue;
+        }
+        JobEntry entry = defaults;
+        entry.first = 0;
+        bool valid = (fields.size() == 2 || fields.size() == 4 || fields.size() == 5) && parseElementType(fields[0], entry.type);
+        try {
+            if (valid) {
+                entry.count = std::stoull(fields[1]);
+            }
+            if (valid && fields.size() >= 4) {
+                entry.minCoord = std::stod(fields[2]);
+                entry.maxCoord = std::stod(fields[3]);
+            }
+            if (valid && fields.size() == 5) {
+                entry.seed = std::stoull(fields[4]);
+            }
+        }
+        catch (const std::exception&) {
+            valid = false;
+        }
+        if (!valid) {
+            std::cerr << path << ":" << lineNumber << ": expected TYPE COUNT [MIN MAX [SEED]]" << std::endl;
+            return false;
+        }
+        entries.push_back(entry);
+    }
+    if (entries.empty()) {
+        std::cerr << "Job file " << path << " has no entries" << std::endl;
+        return false;
     }
-    return nodes;
+    return true;
 }
 
-// quadratic points moved at 1/4 edge length area
-double random_disturb_num(double low, double up, double scale = 0.15)
+void printUsage(const char* program)
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --type NAME         element type, e.g. LINEAR_HEXA (default QUADRATIC_TRIANGLE)\n"
+              << "  --count N           number of elements (default 10)\n"
+              << "  --min X, --max X    coordinate bounds (default 0 and 10)\n"
+              << "  --seed S            run seed (default: current time, printed at start)\n"
+              << "  --threads N         generation threads (default: hardware threads)\n"
+              << "  --element I         regenerate only element I of the run\n"
+              << "  --range FIRST:LAST  regenerate only elements FIRST..LAST (inclusive)\n"
+              << "  --job FILE          generate every TYPE COUNT [MIN MAX [SEED]] line of FILE in one run,\n"
+              << "                      sharing threads and output files (RandomElements<k>.bin per entry)\n"
+              << "  --mesh NX:NY[:NZ]   one connected mesh of the type on an NX x NY x NZ cell grid over the\n"
+              << "                      bounds box, with shared nodes (NZ is ignored by 2D types)\n"
+              << "  --jitter F          mesh vertex jitter as a fraction of the cell size (default 0.15;\n"
+              << "                      below 1/6 no element is inverted)\n"
+              << "  --stream            generate and write in batches on separate threads (constant memory)\n"
+              << "  --batch-size N      elements per batch in --stream mode (default 65536)\n"
+              << "  --valid             regenerate random elements that are inverted or degenerate\n"
+              << "  --min-jacobian X    regenerate random elements whose scaled Jacobian is <= X, X < 1\n"
+              << "                      (implies --valid)\n"
+              << "  --max-attempts N    random candidates per element before it is pulled towards the\n"
+              << "                      ideal shape until valid (default 1000, implies --valid);\n"
+              << "                      failing standard shapes are replaced too\n"
+              << "  --quality-target H  shape random elements to a histogram of scaled Jacobian, H is\n"
+              << "                      low:high:fraction,... e.g. 0:0.2:0.2,0.2:0.7:0.6,0.7:1:0.2\n"
+              << "  --quality           append scaled Jacobian, aspect ratio, skew, size and min edge\n"
+              << "                      to every Metric.txt line and print a summary\n"
+              << "  --output LIST       comma-separated outputs: metric (Metric.txt), nas, bin\n"
+              << "                      (RandomElements.bin, see elementBinaryReader.h); default metric,nas\n"
+              << "  --nas LAYOUT        deck (one RandomElements.nas, default) or per-element\n"
+              << "  --out-dir DIR       output directory, with trailing separator\n"
+              << "  --stats             print timers and counters per thread at the end (needs a build\n"
+              << "                      with -DELEMENT_INSTRUMENTATION)\n"
+              << "  --stats-json FILE   write the timers and counters as JSON" << std::endl;
+}
 
-    std::uniform_real_distribution<double> dist(-1.0, 1.0);
-    double rand_num = dist(gen);
+int main(int argc, char* argv[]) {
 
-    return std::abs(up - low) * scale * rand_num;
-}
+    ElementType type = ElementType::QUADRATIC_TRIANGLE;
+    std::uint64_t numElements = 10;
+    double minCoord = 0.0;
+    double maxCoord = 10.0;
+    std::uint64_t seed = static_cast<std::uint64_t>(std::time(0));
+    unsigned numThreads = std::thread::hardware_concurrency();
+    std::uint64_t first = 0;
+    std::uint64_t last = 0;
+    bool subset = false;
+    std::string outDir = "C:\\Users\\PC\\Desktop\\Test\\";
+    NastranWriter::Layout nasLayout = NastranWriter::Layout::Deck;
+    bool stream = false;
+    bool writeMetric = true;
+    bool writeNastran = true;
+    bool writeBinary = false;
+    bool withQuality = false;
+    bool validOnly = false;
+    double minJacobian = 0.0;
+    int maxAttempts = 1000;
+    QualityTarget qualityTarget;
+    bool targeted = false;
+    std::size_t batchSize = 65536;
+    std::string jobFile;
+    bool printStats = false;
+    std::string statsJson;
+    bool meshMode = false;
+    MeshOptions meshOptions;
 
-void addQuadraticNodes(std::vector<std::vector<double>>& randomNodes, ElementType elmType)
-{
-    switch(elmType)
-    {
-        case ElementType::QUADRATIC_TRIANGLE:
-        {
-            int qdrNds = 3;
-            std::vector<std::vector<double>> quadraticNodes(qdrNds, std::vector<double>(3, 0.0));
-            for (int i = 0; i < qdrNds; ++i)
-            {
-                quadraticNodes[i][0] = 0.5 * (randomNodes[i][0] + randomNodes[(i+1)%qdrNds][0]) + random_disturb_num(randomNodes[i][0], randomNodes[(i+1)%qdrNds][0]);
-                quadraticNodes[i][1] = 0.5 * (randomNodes[i][1] + randomNodes[(i+1)%qdrNds][1]) + random_disturb_num(randomNodes[i][1], randomNodes[(i+1)%qdrNds][1]);
-                quadraticNodes[i][2] = 0.5 * (randomNodes[i][2] + randomNodes[(i+1)%qdrNds][2]) + random_disturb_num(randomNodes[i][2], randomNodes[(i+1)%qdrNds][2]);
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (arg == "--stream") {
+            stream = true;
+            continue;
+        }
+        if (arg == "--quality") {
+            withQuality = true;
+            continue;
+        }
+        if (arg == "--valid") {
+            validOnly = true;
+            continue;
+        }
+        if (arg == "--stats") {
+            printStats = true;
+            continue;
+        }
+        if (a + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string value = argv[++a];
+        try {
+            if (arg == "--type") {
+                if (!parseElementType(value, type)) {
+                    std::cerr << "Unknown element type " << value << std::endl;
+                    return 1;
+                }
             }
-            randomNodes.insert(randomNodes.end(), quadraticNodes.begin(), quadraticNodes.end());
-            break;
-        }
-        case ElementType::QUADRATIC_QUAD:
-        {
-            int qdrNds = 4;
-            std::vector<std::vector<double>> quadraticNodes(qdrNds, std::vector<double>(3, 0.0));
-            for (int i = 0; i < qdrNds; ++i)
-            {
-                quadraticNodes[i][0] = 0.5 * (randomNodes[i][0] + randomNodes[(i+1)%qdrNds][0]) + random_disturb_num(randomNodes[i][0], randomNodes[(i+1)%qdrNds][0]);
-                quadraticNodes[i][1] = 0.5 * (randomNodes[i][1] + randomNodes[(i+1)%qdrNds][1]) + random_disturb_num(randomNodes[i][1], randomNodes[(i+1)%qdrNds][1]);
-                quadraticNodes[i][2] = 0.5 * (randomNodes[i][2] + randomNodes[(i+1)%qdrNds][2]) + random_disturb_num(randomNodes[i][2], randomNodes[(i+1)%qdrNds][2]);
+            else if (arg == "--count") {
+                numElements = std::stoull(value);
             }
-            randomNodes.insert(randomNodes.end(), quadraticNodes.begin(), quadraticNodes.end());
-            break;
-        }
-        case ElementType::QUADRATIC_TETRA:
-        {
-            int qdrNds = 6;
-            std::vector<std::vector<double>> quadraticNodes(qdrNds, std::vector<double>(3, 0.0));
-            for (int i = 0; i < 4; ++i)
-            {
-                quadraticNodes[i][0] = 0.5 * (randomNodes[i][0] + randomNodes[(i+1)%4][0]) + random_disturb_num(randomNodes[i][0], randomNodes[(i+1)%4][0]);
-                quadraticNodes[i][1] = 0.5 * (randomNodes[i][1] + randomNodes[(i+1)%4][1]) + random_disturb_num(randomNodes[i][1], randomNodes[(i+1)%4][1]);
-                quadraticNodes[i][2] = 0.5 * (randomNodes[i][2] + randomNodes[(i+1)%4][2]) + random_disturb_num(randomNodes[i][2], randomNodes[(i+1)%4][2]);
+            else if (arg == "--min") {
+                minCoord = std::stod(value);
             }
-
-            quadraticNodes[4][0] = 0.5 * (randomNodes[1][0] + randomNodes[3][0]) + random_disturb_num(randomNodes[1][0], randomNodes[3][0]);
-            quadraticNodes[4][1] = 0.5 * (randomNodes[1][1] + randomNodes[3][1]) + random_disturb_num(randomNodes[1][1], randomNodes[3][1]);
-            quadraticNodes[4][2] = 0.5 * (randomNodes[1][2] + randomNodes[3][2]) + random_disturb_num(randomNodes[1][2], randomNodes[3][2]);
-
-            quadraticNodes[5][0] = 0.5 * (randomNodes[2][0] + randomNodes[3][0]) + random_disturb_num(randomNodes[2][0], randomNodes[3][0]);
-            quadraticNodes[5][1] = 0.5 * (randomNodes[2][1] + randomNodes[3][1]) + random_disturb_num(randomNodes[2][1], randomNodes[3][1]);
-            quadraticNodes[5][2] = 0.5 * (randomNodes[2][2] + randomNodes[3][2]) + random_disturb_num(randomNodes[2][2], randomNodes[3][2]);
-
-            randomNodes.insert(randomNodes.end(), quadraticNodes.begin(), quadraticNodes.end());
-            break;
-        }
-        case ElementType::QUADRATIC_HEX:
-        {
-            int qdrNds = 12;
-            std::vector<std::vector<double>> quadraticNodes(qdrNds, std::vector<double>(3, 0.0));
-            for (int i = 0; i < 4; ++i)
-            {
-                quadraticNodes[i][0] = 0.5 * (randomNodes[i][0] + randomNodes[(i+1)%4][0]) + random_disturb_num(randomNodes[i][0], randomNodes[(i+1)%4][0]);
-                quadraticNodes[i][1] = 0.5 * (randomNodes[i][1] + randomNodes[(i+1)%4][1]) + random_disturb_num(randomNodes[i][1], randomNodes[(i+1)%4][1]);
-                quadraticNodes[i][2] = 0.5 * (randomNodes[i][2] + randomNodes[(i+1)%4][2]) + random_disturb_num(randomNodes[i][2], randomNodes[(i+1)%4][2]);
+            else if (arg == "--max") {
+                maxCoord = std::stod(value);
             }
-
-            for (int i = 0; i < 4; ++i)
-            {
-                quadraticNodes[i+4][0] = 0.5 * (randomNodes[i][0] + randomNodes[(i+4)%8][0]) + random_disturb_num(randomNodes[i][0], randomNodes[(i+4)%8][0]);
-                quadraticNodes[i+4][1] = 0.5 * (randomNodes[i][1] + randomNodes[(i+4)%8][1]) + random_disturb_num(randomNodes[i][1], randomNodes[(i+4)%8][1]);
-                quadraticNodes[i+4][2] = 0.5 * (randomNodes[i][2] + randomNodes[(i+4)%8][2]) + random_disturb_num(randomNodes[i][2], randomNodes[(i+4)%8][2]);
+            else if (arg == "--seed") {
+                seed = std::stoull(value);
             }
-
-            for (int i = 0; i < 4; ++i)
-            {
-                quadraticNodes[i+8][0] = 0.5 * (randomNodes[i+4][0] + randomNodes[(i+1)%4+4][0]) + random_disturb_num(randomNodes[i+4][0], randomNodes[(i+1)%4+4][0]);
-                quadraticNodes[i+8][1] = 0.5 * (randomNodes[i+4][1] + randomNodes[(i+1)%4+4][1]) + random_disturb_num(randomNodes[i+4][1], randomNodes[(i+1)%4+4][1]);
-                quadraticNodes[i+8][2] = 0.5 * (randomNodes[i+4][2] + randomNodes[(i+1)%4+4][2]) + random_disturb_num(randomNodes[i+4][2], randomNodes[(i+1)%4+4][2]);
+            else if (arg == "--threads") {
+                numThreads = static_cast<unsigned>(std::stoul(value));
             }
-            randomNodes.insert(randomNodes.end(), quadraticNodes.begin(), quadraticNodes.end());
-            break;
-        }
-    }
-}
-
-std::vector<std::vector<std::vector<double>>> getStandardElement(ElementType type, double minCoord, double maxCoord) {
-    switch (type) {
-        case ElementType::LINEAR_TRIANGLE: {
-            std::vector<std::vector<std::vector<double>>> elements;
-            // ET
-            std::vector<std::vector<double>> nodes(3, std::vector<double>(3, 0.0));
-            nodes[0][0] = minCoord; nodes[0][1] = minCoord; nodes[0][2] = minCoord;
-            nodes[1][0] = maxCoord; nodes[1][1] = minCoord; nodes[1][2] = maxCoord;
-            nodes[2][0] = minCoord; nodes[2][1] = maxCoord; nodes[2][2] = maxCoord;
-            elements.push_back(nodes);
-            // RT
-            std::vector<std::vector<double>> nodes1(3, std::vector<double>(3, 0.0));
-            nodes1[0][0] = minCoord; nodes1[0][1] = minCoord; nodes1[0][2] = minCoord;
-            nodes1[1][0] = maxCoord; nodes1[1][1] = minCoord; nodes1[1][2] = minCoord;
-            nodes1[2][0] = minCoord; nodes1[2][1] = maxCoord; nodes1[2][2] = maxCoord;
-            elements.push_back(nodes1);
-            return elements;
-        }
-        case ElementType::LINEAR_QUAD: {
-            std::vector<std::vector<std::vector<double>>> elements;
-            // square
-            std::vector<std::vector<double>> nodes(4, std::vector<double>(3, 0.0));
-            nodes[0][0] = minCoord; nodes[0][1] = minCoord; nodes[0][2] = minCoord;
-            nodes[1][0] = maxCoord; nodes[1][1] = minCoord; nodes[1][2] = minCoord;
-            nodes[2][0] = maxCoord; nodes[2][1] = minCoord; nodes[2][2] = maxCoord;
-            nodes[3][0] = minCoord; nodes[3][1] = minCoord; nodes[3][2] = maxCoord;
-            elements.push_back(nodes);
-            // 10:1 rectangle
-            std::vector<std::vector<double>> nodes1(4, std::vector<double>(3, 0.0));
-            nodes1[0][0] = minCoord; nodes1[0][1] = minCoord; nodes1[0][2] = minCoord;
-            nodes1[1][0] = maxCoord; nodes1[1][1] = minCoord; nodes1[1][2] = minCoord;
-            nodes1[2][0] = maxCoord; nodes1[2][1] = minCoord; nodes1[2][2] = minCoord + 0.1 * (maxCoord - minCoord);
-            nodes1[3][0] = minCoord; nodes1[3][1] = minCoord; nodes1[3][2] = minCoord + 0.1 * (maxCoord - minCoord);
-            elements.push_back(nodes1);
-            // tri-rectangle
-            std::vector<std::vector<double>> nodes2(4, std::vector<double>(3, 0.0));
-            nodes1[0][0] = minCoord; nodes1[0][1] = minCoord; nodes1[0][2] = minCoord;
-            nodes1[1][0] = maxCoord; nodes1[1][1] = minCoord; nodes1[1][2] = minCoord;
-            nodes2[2][0] = 0.5 * (minCoord + maxCoord); nodes2[2][1] = 0.5 * (minCoord + maxCoord); nodes1[2][2] = 0.5 * (minCoord + maxCoord);
-            nodes1[3][0] = minCoord; nodes1[3][1] = maxCoord; nodes1[3][2] = maxCoord;
-            elements.push_back(nodes1);
-            return elements;
-        }
-        case ElementType::LINEAR_TETRA: {
-            std::vector<std::vector<std::vector<double>>> elements;
-            // regular tetra
-            std::vector<std::vector<double>> nodes(4, std::vector<double>(3, 0.0));
-            nodes[0][0] = minCoord; nodes[0][1] = minCoord; nodes[0][2] = minCoord;
-            nodes[1][0] = maxCoord; nodes[1][1] = minCoord; nodes[1][2] = maxCoord;
-            nodes[2][0] = maxCoord; nodes[2][1] = maxCoord; nodes[2][2] = minCoord;
-            nodes[3][0] = minCoord; nodes[3][1] = maxCoord; nodes[3][2] = maxCoord;
-            elements.push_back(nodes);
-            // right angle tetra
-            std::vector<std::vector<double>> nodes1(4, std::vector<double>(3, 0.0));
-            nodes1[0][0] = minCoord; nodes1[0][1] = minCoord; nodes1[0][2] = minCoord;
-            nodes1[1][0] = maxCoord; nodes1[1][1] = minCoord; nodes1[1][2] = minCoord;
-            nodes1[2][0] = minCoord; nodes1[2][1] = maxCoord; nodes1[2][2] = minCoord;
-            nodes1[3][0] = minCoord; nodes1[3][1] = minCoord; nodes1[3][2] = maxCoord;
-            elements.push_back(nodes1);
-            return elements;
-        }
-        case ElementType::LINEAR_HEXA: {
-            std::vector<std::vector<std::vector<double>>> elements;
-            // Cube
-            std::vector<std::vector<double>> nodes(8, std::vector<double>(3, 0.0));
-            nodes[0][0] = minCoord; nodes[0][1] = minCoord; nodes[0][2] = minCoord;
-            nodes[1][0] = maxCoord; nodes[1][1] = minCoord; nodes[1][2] = minCoord;
-            nodes[2][0] = maxCoord; nodes[2][1] = maxCoord; nodes[2][2] = minCoord;
-            nodes[3][0] = minCoord; nodes[3][1] = maxCoord; nodes[3][2] = minCoord;
-            nodes[4][0] = minCoord; nodes[4][1] = minCoord; nodes[4][2] = maxCoord;
-            nodes[5][0] = maxCoord; nodes[5][1] = minCoord; nodes[5][2] = maxCoord;
-            nodes[6][0] = maxCoord; nodes[6][1] = maxCoord; nodes[6][2] = maxCoord;
-            nodes[7][0] = minCoord; nodes[7][1] = maxCoord; nodes[7][2] = maxCoord;
-            elements.push_back(nodes);
-            // 10:10:1 Cube
-            std::vector<std::vector<double>> nodes1(8, std::vector<double>(3, 0.0));
-            nodes1[0][0] = minCoord; nodes1[0][1] = minCoord; nodes1[0][2] = minCoord;
-            nodes1[1][0] = maxCoord; nodes1[1][1] = minCoord; nodes1[1][2] = minCoord;
-            nodes1[2][0] = maxCoord; nodes1[2][1] = maxCoord; nodes1[2][2] = minCoord;
-            nodes1[3][0] = minCoord; nodes1[3][1] = maxCoord; nodes1[3][2] = minCoord;
-            nodes1[4][0] = minCoord; nodes1[4][1] = minCoord; nodes1[4][2] = minCoord + 0.1 * (maxCoord - minCoord);
-            nodes1[5][0] = maxCoord; nodes1[5][1] = minCoord; nodes1[5][2] = minCoord + 0.1 * (maxCoord - minCoord);
-            nodes1[6][0] = maxCoord; nodes1[6][1] = maxCoord; nodes1[6][2] = minCoord + 0.1 * (maxCoord - minCoord);
-            nodes1[7][0] = minCoord; nodes1[7][1] = maxCoord; nodes1[7][2] = minCoord + 0.1 * (maxCoord - minCoord);
-            elements.push_back(nodes1);
-            return elements;
-        }
-        case ElementType::LINEAR_PYRAMID: {
-            std::vector<std::vector<std::vector<double>>> elements;
-            //
-            std::vector<std::vector<double>> nodes(5, std::vector<double>(3, 0.0));
-            nodes[0][0] = minCoord; nodes[0][1] = minCoord; nodes[0][2] = minCoord;
-            nodes[1][0] = maxCoord; nodes[1][1] = minCoord; nodes[1][2] = minCoord;
-            nodes[2][0] = maxCoord; nodes[2][1] = maxCoord; nodes[2][2] = minCoord;
-            nodes[3][0] = minCoord; nodes[3][1] = maxCoord; nodes[3][2] = minCoord;
-            nodes[4][0] = 0.5 * (minCoord + maxCoord); nodes[4][1] = 0.5 * (minCoord + maxCoord); nodes[4][2] = maxCoord;
-            elements.push_back(nodes);
-            // right angle pyramid
-            std::vector<std::vector<double>> nodes1(5, std::vector<double>(3, 0.0));
-            nodes1[0][0] = minCoord; nodes1[0][1] = minCoord; nodes1[0][2] = minCoord;
-            nodes1[1][0] = maxCoord; nodes1[1][1] = minCoord; nodes1[1][2] = minCoord;
-            nodes1[2][0] = maxCoord; nodes1[2][1] = maxCoord; nodes1[2][2] = minCoord;
-            nodes1[3][0] = minCoord; nodes1[3][1] = maxCoord; nodes1[3][2] = minCoord;
-            nodes1[4][0] = minCoord; nodes1[4][1] = minCoord; nodes1[4][2] = maxCoord;
-            elements.push_back(nodes1);
-            return elements;
-        }
-        case ElementType::LINEAR_PRISM: {
-            std::vector<std::vector<std::vector<double>>> elements;
-            // Isosceles prism
-            std::vector<std::vector<double>> nodes(6, std::vector<double>(3, 0.0));
-            nodes[0][0] = minCoord; nodes[0][1] = minCoord; nodes[0][2] = minCoord;
-            nodes[1][0] = maxCoord; nodes[1][1] = minCoord; nodes[1][2] = minCoord;
-            nodes[2][0] = 0.5 * (minCoord + maxCoord); nodes[2][1] = maxCoord; nodes[2][2] = minCoord;
-            nodes[3][0] = minCoord; nodes[3][1] = minCoord; nodes[3][2] = maxCoord;
-            nodes[4][0] = maxCoord; nodes[4][1] = minCoord; nodes[4][2] = maxCoord;
-            nodes[5][0] = 0.5 * (minCoord + maxCoord); nodes[5][1] = maxCoord; nodes[5][2] = maxCoord;
-            elements.push_back(nodes);
-            // right angle prism
-            std::vector<std::vector<double>> nodes1(6, std::vector<double>(3, 0.0));
-            nodes1[0][0] = minCoord; nodes1[0][1] = minCoord; nodes1[0][2] = minCoord;
-            nodes1[1][0] = maxCoord; nodes1[1][1] = minCoord; nodes1[1][2] = minCoord;
-            nodes1[2][0] = minCoord; nodes1[2][1] = maxCoord; nodes1[2][2] = minCoord;
-            nodes1[3][0] = minCoord; nodes1[3][1] = minCoord; nodes1[3][2] = maxCoord;
-            nodes1[4][0] = maxCoord; nodes1[4][1] = minCoord; nodes1[4][2] = maxCoord;
-            nodes1[5][0] = minCoord; nodes1[5][1] = maxCoord; nodes1[5][2] = maxCoord;
-            elements.push_back(nodes1);
-            return elements;
-        }
-        default:
-        {
-            std::vector<std::vector<std::vector<double>>> invalid = {{{0.0}}};
-            return invalid;
-        }
-    }
-}
-
-std::vector<std::vector<std::vector<double>>> generateElements(ElementType type, int numElements, double minCoord, double maxCoord) {
-    std::vector<std::vector<std::vector<double>>> elements = getStandardElement(type, minCoord, maxCoord);
-    for (int i = 2; i < numElements; ++i) {
-        std::vector<std::vector<double>> randomNodes;
-        switch (type) {
-            case ElementType::LINEAR_TRIANGLE: {
-                randomNodes = generateNodes(3, minCoord, maxCoord);
-                break;
+            else if (arg == "--element") {
+                first = last = std::stoull(value);
+                subset = true;
             }
-            case ElementType::LINEAR_QUAD: {
-                randomNodes = generateNodes(4, minCoord, maxCoord);
-                break;
+            else if (arg == "--range") {
+                std::size_t colon = value.find(':');
+                if (colon == std::string::npos) {
+                    std::cerr << "--range expects FIRST:LAST" << std::endl;
+                    return 1;
+                }
+                first = std::stoull(value.substr(0, colon));
+                last = std::stoull(value.substr(colon + 1));
+                subset = true;
             }
-            case ElementType::LINEAR_TETRA: {
-                randomNodes = generateNodes(4, minCoord, maxCoord);
-                break;
+            else if (arg == "--min-jacobian") {
+                minJacobian = std::stod(value);
+                if (!(minJacobian < 1.0)) {
+                    std::cerr << "--min-jacobian must be below 1" << std::endl;
+                    return 1;
+                }
+                validOnly = true;
             }
-            case ElementType::LINEAR_HEXA: {
-                randomNodes = generateNodes(8, minCoord, maxCoord);
-                break;
+            else if (arg == "--max-attempts") {
+                maxAttempts = std::stoi(value);
+                if (maxAttempts < 1) {
+                    std::cerr << "--max-attempts needs at least one attempt" << std::endl;
+                    return 1;
+                }
+                validOnly = true;
             }
-            case ElementType::LINEAR_PYRAMID: {
-                randomNodes = generateNodes(5, minCoord, maxCoord);
-                break;
+            else if (arg == "--quality-target") {
+                if (!qualityTarget.parse(value)) {
+                    std::cerr << "--quality-target expects low:high:fraction,..." << std::endl;
+                    return 1;
+                }
+                targeted = true;
             }
-            case ElementType::LINEAR_PRISM: {
-                randomNodes = generateNodes(6, minCoord, maxCoord);
-                break;
+            else if (arg == "--batch-size") {
+                batchSize = static_cast<std::size_t>(std::stoull(value));
             }
-            case ElementType::QUADRATIC_TRIANGLE: {
-                randomNodes = generateNodes(3, minCoord, maxCoord);
-                addQuadraticNodes(randomNodes, ElementType::QUADRATIC_TRIANGLE);
-                break;
+            else if (arg == "--output") {
+                writeMetric = writeNastran = writeBinary = false;
+                std::size_t begin = 0;
+                while (begin <= value.size()) {
+                    std::size_t comma = value.find(',', begin);
+                    std::string item = value.substr(begin, comma == std::string::npos ? std::string::npos : comma - begin);
+                    if (item == "metric") {
+                        writeMetric = true;
+                    }
+                    else if (item == "nas") {
+                        writeNastran = true;
+                    }
+                    else if (item == "bin") {
+                        writeBinary = true;
+                    }
+                    else {
+                        std::cerr << "Unknown output " << item << std::endl;
+                        return 1;
+                    }
+                    if (comma == std::string::npos) {
+                        break;
+                    }
+                    begin = comma + 1;
+                }
             }
-            case ElementType::QUADRATIC_QUAD: {
-                randomNodes = generateNodes(4, minCoord, maxCoord);
-                addQuadraticNodes(randomNodes, ElementType::QUADRATIC_QUAD);
-                break;
+            else if (arg == "--nas") {
+                if (value == "deck") {
+                    nasLayout = NastranWriter::Layout::Deck;
+                }
+                else if (value == "per-element") {
+                    nasLayout = NastranWriter::Layout::PerElement;
+                }
+                else {
+                    std::cerr << "--nas expects deck or per-element" << std::endl;
+                    return 1;
+                }
             }
-            case ElementType::QUADRATIC_TETRA: {
-                randomNodes = generateNodes(4, minCoord, maxCoord);
-                addQuadraticNodes(randomNodes, ElementType::QUADRATIC_TETRA);
-                break;
+            else if (arg == "--mesh") {
+                std::size_t colon = value.find(':');
+                std::size_t second = colon == std::string::npos ? colon : value.find(':', colon + 1);
+                if (colon == std::string::npos) {
+                    std::cerr << "--mesh expects NX:NY[:NZ]" << std::endl;
+                    return 1;
+                }
+                meshOptions.cells[0] = std::stoull(value.substr(0, colon));
+                meshOptions.cells[1] = std::stoull(value.substr(colon + 1, second == std::string::npos ? std::string::npos : second - colon - 1));
+                meshOptions.cells[2] = second == std::string::npos ? 1 : std::stoull(value.substr(second + 1));
+                if (meshOptions.cells[0] == 0 || meshOptions.cells[1] == 0 || meshOptions.cells[2] == 0) {
+                    std::cerr << "--mesh needs at least one cell per axis" << std::endl;
+                    return 1;
+                }
+                meshMode = true;
             }
-            case ElementType::QUADRATIC_HEX: {
-                randomNodes = generateNodes(8, minCoord, maxCoord);
-                addQuadraticNodes(randomNodes, ElementType::QUADRATIC_HEX);
-                break;
+            else if (arg == "--jitter") {
+                meshOptions.jitter = std::stod(value);
+                if (!(meshOptions.jitter >= 0.0)) {
+                    std::cerr << "--jitter must not be negative" << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--out-dir") {
+                outDir = value;
+            }
+            else if (arg == "--job") {
+                jobFile = value;
+            }
+            else if (arg == "--stats-json") {
+                statsJson = value;
+            }
+            else {
+                std::cerr << "Unknown option " << arg << std::endl;
+                printUsage(argv[0]);
+                return 1;
             }
         }
-        try {
-            elements.push_back(randomNodes);
-        }
-        catch (const std::bad_alloc& e)
-        {
-            std::cerr << e.what() << std::endl;
+        catch (const std::exception&) {
+            std::cerr << "Invalid value " << value << " for " << arg << std::endl;
+            return 1;
         }
-
     }
-    return elements;
-}
-
-int main() {
-    std::srand(static_cast<unsigned int>(std::time(0)));
-
-    ElementType type = ElementType::QUADRATIC_TRIANGLE;
-    int numElements = 10;
-    double minCoord = 0.0;
-    double maxCoord = 10.0;
-
-    std::vector<std::vector<std::vector<double>>> element = generateElements(type, numElements, minCoord, maxCoord);
+    if (subset && last < first) {
+        std::cerr << "Empty element range" << std::endl;
+        return 1;
+    }
+    if (!subset) {
+        first = 0;
+        last = numElements > 0 ? numElements - 1 : 0;
+    }
+    std::uint64_t count = (subset || numElements > 0) ? last - first + 1 : 0;
+    if (meshMode && (subset || !jobFile.empty() || validOnly || targeted || nasLayout != NastranWriter::Layout::Deck)) {
+        std::cerr << "--mesh cannot be combined with --element, --range, --job, --valid, --quality-target or --nas per-element" << std::endl;
+        return 1;
+    }
+    if (validOnly && targeted) {
+        std::cerr << "--quality-target cannot be combined with --valid, --min-jacobian or --max-attempts" << std::endl;
+        return 1;
+    }
+    if (meshMode && !meshSupported(type)) {
+        std::cerr << "No mesh of " << elementTypeName(type) << " elements" << std::endl;
+        return 1;
+    }
 
-    std::ofstream outFile;
+    std::vector<JobEntry> entries;
+    JobEntry defaults = { type, first, count, minCoord, maxCoord, seed };
+    if (!jobFile.empty()) {
+        if (!readJobFile(jobFile, defaults, entries)) {
+            return 1;
+        }
+    }
+    else if (!meshMode) {
+        entries.push_back(defaults);
+    }
 
-    outFile.open("C:\\Users\\PC\\Desktop\\Test\\Metric.txt");
-    if(!outFile.is_open()) {
-        std::cerr << "Failed to open the file." <<std::endl;
+    MetricWriter metric;
+    if (writeMetric && !metric.open(outDir + "Metric.txt")) {
+        std::cerr << "Failed to open the file." << std::endl;
+        return 1;
+    }
+    NastranWriter nastran;
+    if (writeNastran && !nastran.open(outDir, nasLayout)) {
+        std::cerr << "Failed to open the file!" << std::endl;
         return 1;
     }
+    BinaryWriter binary;
+    QualityMetrics quality;
+    QualitySummary qualitySummary;
+    ElementSink sink = [&](const ElementBatch& batch, std::uint64_t firstIndex) {
+        if (withQuality) {
+            computeQuality(batch, quality);
+            qualitySummary.add(quality, batch.size());
+        }
+        if (writeMetric) {
+            metric.write(batch, withQuality ? &quality : nullptr);
+        }
+        if (writeNastran && !nastran.write(batch, firstIndex)) {
+            return false;
+        }
+        return !writeBinary || binary.write(batch);
+    };
 
-    for (int i = 0; i < (int)element.size(); ++i) {
-        for (int j = 0; j < (int)element[i].size(); ++j) {
-            outFile << "{" << element[i][j][0] << "," << element[i][j][1] << "," << element[i][j][2] << "}";
+    ValidityFilter validity(minJacobian, maxAttempts);
+    ThreadPool pool(numThreads > 0 ? numThreads : 1);
+    // per type: elements, bytes and seconds over all entries of a job
+    std::uint64_t typeElements[NumElementTypes] = {};
+    std::uint64_t typeBytes[NumElementTypes] = {};
+    double typeSeconds[NumElementTypes] = {};
+    std::uint64_t idBase = 0;
+    std::uint64_t gridBase = 0;
+    bool written = true;
+    if (meshMode) {
+        meshOptions.minCoord = minCoord;
+        meshOptions.maxCoord = maxCoord;
+        meshOptions.seed = seed;
+        std::cout << "Mesh of " << elementTypeName(type) << ", seed " << seed << std::endl;
+        if (writeBinary && !binary.open(outDir + "RandomElements.bin", type, seed, 0, minCoord, maxCoord)) {
+            std::cerr << "Failed to open the file!" << std::endl;
+            return 1;
+        }
+        // metric and binary output get the element coordinates as in a run,
+        // the deck gets every shared node once
+        MeshSink meshSink = [&](const MeshPartition& partition) {
+            if (withQuality) {
+                computeQuality(partition.elements, quality);
+                qualitySummary.add(quality, partition.elements.size());
+            }
+            if (writeMetric) {
+                metric.write(partition.elements, withQuality ? &quality : nullptr);
+            }
+            if (writeNastran) {
+                nastran.writeNodes(partition.nodeIds.data(), partition.nodeX.data(), partition.nodeY.data(),
+                                   partition.nodeZ.data(), partition.nodeIds.size());
+                if (!nastran.writeConnectivity(type, partition.firstElement, partition.connectivity.data(), partition.elements.size())) {
+                    return false;
+                }
+            }
+            return !writeBinary || binary.write(partition.elements);
+        };
+        auto start = std::chrono::steady_clock::now();
+        written = streamMesh(type, meshOptions, pool, batchSize, 2, meshSink);
+        if (writeBinary && !binary.close()) {
+            written = false;
         }
-        outFile << std::endl;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::uint64_t elements = meshElementCount(type, meshOptions);
+        std::cout << "  " << elements << " elements, " << meshNodeCount(type, meshOptions) << " nodes ("
+                  << elements * static_cast<std::uint64_t>(nodesPerElement(type)) << " element nodes), "
+                  << seconds << " s" << std::endl;
     }
-    outFile.close();
-
-    for (int i = 0; i < (int)element.size(); ++i)
-    {
-        std::string filePath = "C:\\Users\\PC\\Desktop\\Test\\RandomElement" + std::to_string(i) + ".nas";
-        outFile.open(filePath.c_str());
-        if(!outFile.is_open())
-        {
+    for (std::size_t k = 0; k < entries.size() && written; ++k) {
+        const JobEntry& entry = entries[k];
+        std::cout << "Type " << elementTypeName(entry.type) << ", seed " << entry.seed << std::endl;
+        std::string binaryPath = outDir + (jobFile.empty() ? std::string("RandomElements.bin") : "RandomElements" + std::to_string(k) + ".bin");
+        if (writeBinary && !binary.open(binaryPath, entry.type, entry.seed, entry.first, entry.minCoord, entry.maxCoord)) {
             std::cerr << "Failed to open the file!" << std::endl;
             return 1;
         }
-        outFile << "BEGIN BULK" <<std::endl;
-        for (int j = 0; j < (int)element[i].size(); ++j)
-        {
-            outFile << "GRID," << j+1 << ",," << element[i][j][0] << "," << element[i][j][1] << "," << element[i][j][2] << std::endl;
-        }
-        switch(type)
-        {
-            case ElementType::LINEAR_TRIANGLE:
-                outFile << "CTRIA3,1,1,1,2,3" << std::endl; 
-                break;
-            case ElementType::LINEAR_QUAD:
-                outFile << "CQUAD4,1,1,1,2,3,4" << std::endl;
-                break;
-            case ElementType::LINEAR_TETRA:
-                outFile << "CTETRA,1,1,1,2,3,4" << std::endl;
-                break;
-            case ElementType::LINEAR_HEXA:
-                outFile << "CHEXA,1,1,1,2,3,4,5,6,7,8" << std::endl;
-                break;
-            case ElementType::QUADRATIC_TRIANGLE:
-                outFile << "CTRIA6,1,1,1,2,3,4,5,6" << std::endl;
-                break;
-            case ElementType::QUADRATIC_QUAD:
-                outFile << "CQUAD8,1,1,1,2,3,4,5,6,7,8" << std::endl;
-                break;
-            case ElementType::QUADRATIC_TETRA:
-                outFile << "CTETRA,1,1,1,2,3,4,5,6,7,8,9,10" << std::endl;
-                break;
-            case ElementType::QUADRATIC_HEX:
-                outFile << "CHEXA,1,1,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,18,20" << std::endl;
-                break;
-        }
-        outFile << "ENDDATA" << std::endl;
-        outFile.close();
-     }
+        nastran.setIdBase(gridBase, idBase);
+        std::uint64_t bytesBefore = metric.bytesWritten() + nastran.bytesWritten() + binary.bytesWritten();
+        auto start = std::chrono::steady_clock::now();
+
+        GenerationOptions options;
+        options.minCoord = entry.minCoord;
+        options.maxCoord = entry.maxCoord;
+        options.seed = entry.seed;
+        options.validity = validOnly ? &validity : nullptr;
+        options.target = targeted ? &qualityTarget : nullptr;
+        if (stream) {
+            written = streamElements(entry.type, entry.first, entry.count, options, pool, batchSize, 2, sink);
+        }
+        else {
+            ElementBatch element = generateElementRange(entry.type, entry.first, static_cast<std::size_t>(entry.count), options, pool);
+            written = element.size() == entry.count && sink(element, entry.first);
+        }
+        if (writeBinary && !binary.close()) {
+            written = false;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::uint64_t bytes = metric.bytesWritten() + nastran.bytesWritten() + binary.bytesWritten() - bytesBefore;
+        int t = static_cast<int>(entry.type);
+        typeElements[t] += entry.count;
+        typeBytes[t] += bytes;
+        typeSeconds[t] += seconds;
+        idBase += entry.first + entry.count;
+        gridBase += (entry.first + entry.count) * static_cast<std::uint64_t>(nodesPerElement(entry.type));
+    }
+    bool closed = true;
+    if (writeMetric && !metric.close()) {
+        closed = false;
+    }
+    if (writeNastran && !nastran.close()) {
+        closed = false;
+    }
+    if (!closed || !written) {
+        std::cerr << "Failed to write the output!" << std::endl;
+        return 1;
+    }
+    if (!jobFile.empty()) {
+        std::cout << "Throughput per type (elements, seconds, elements/s, MB/s written):" << std::endl;
+        for (int t = 0; t < NumElementTypes; ++t) {
+            if (typeElements[t] == 0) {
+                continue;
+            }
+            double seconds = typeSeconds[t] > 0.0 ? typeSeconds[t] : 1e-9;
+            std::cout << "  " << elementTypeName(static_cast<ElementType>(t)) << ": " << typeElements[t] << ", "
+                      << typeSeconds[t] << ", " << static_cast<double>(typeElements[t]) / seconds << ", "
+                      << static_cast<double>(typeBytes[t]) / seconds / 1e6 << std::endl;
+        }
+    }
+    if (targeted) {
+        std::uint64_t produced = 0;
+        for (std::size_t b = 0; b < qualityTarget.bins().size(); ++b) {
+            produced += qualityTarget.numProduced(static_cast<int>(b));
+        }
+        std::cout << "Quality target over " << produced << " random elements:" << std::endl;
+        for (std::size_t b = 0; b < qualityTarget.bins().size() && produced > 0; ++b) {
+            const QualityTarget::Bin& bin = qualityTarget.bins()[b];
+            std::cout << "  [" << bin.low << ", " << bin.high << "]: " << qualityTarget.numProduced(static_cast<int>(b))
+                      << " (" << 100.0 * static_cast<double>(qualityTarget.numProduced(static_cast<int>(b))) / static_cast<double>(produced)
+                      << "%, requested " << 100.0 * bin.fraction << "%)" << std::endl;
+        }
+        if (produced > 0) {
+            std::cout << "  " << static_cast<double>(qualityTarget.numEvaluations()) / static_cast<double>(produced)
+                      << " quality evaluations per element, " << qualityTarget.numMisses() << " outside their bin" << std::endl;
+        }
+    }
+    for (int t = 0; validOnly && t < NumElementTypes; ++t) {
+        ElementType checked = static_cast<ElementType>(t);
+        if (validity.numCandidates(checked) == 0) {
+            continue;
+        }
+        std::cout << "Validity of " << elementTypeName(checked) << " (scaled Jacobian > " << minJacobian << "): accepted "
+                  << validity.numAccepted(checked) << " of " << validity.numCandidates(checked) << " candidates ("
+                  << 100.0 * static_cast<double>(validity.numAccepted(checked)) / static_cast<double>(validity.numCandidates(checked))
+                  << "%)" << std::endl;
+        if (validity.numExhausted(checked) > 0) {
+            std::cout << "  " << validity.numExhausted(checked) << " elements pulled towards the ideal shape after "
+                      << validity.maxAttempts << " attempts" << std::endl;
+        }
+    }
+    if (withQuality && qualitySummary.count() > 0) {
+        std::cout << "Quality over " << qualitySummary.count() << " elements (min / mean / max):" << std::endl;
+        for (int m = 0; m < QualitySummary::NumMetrics; ++m) {
+            std::cout << "  " << QualitySummary::name(m) << ": " << qualitySummary.min(m) << " / "
+                      << qualitySummary.mean(m) << " / " << qualitySummary.max(m) << std::endl;
+        }
+    }
+    if ((printStats || !statsJson.empty()) && !InstrumentationEnabled) {
+        std::cerr << "Built without ELEMENT_INSTRUMENTATION, no statistics recorded" << std::endl;
+    }
+    else {
+        if (printStats) {
+            std::cout << std::flush;
+            printInstrumentation(stdout);
+        }
+        if (!statsJson.empty() && !writeInstrumentationJson(statsJson.c_str())) {
+            std::cerr << "Failed to write " << statsJson << std::endl;
+        }
+    }
     std::cout << "Data has been written to the file." << std::endl;
     return 0;
-}
\ No newline at end of file
+}
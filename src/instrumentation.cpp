@@ -0,0 +1,184 @@
+#include "instrumentation.h"
+
+#ifdef ELEMENT_INSTRUMENTATION
+
+#include <atomic>
+
+namespace
+{
+
+constexpr int NumTimers = static_cast<int>(InstrumentTimer::Count);
+constexpr int NumCounters = static_cast<int>(InstrumentCounter::Count);
+
+// More threads than this share the slots round-robin; the values stay
+// correct, only the per-thread breakdown of those threads is merged
+constexpr int MaxThreads = 256;
+
+// Values of one thread. Static storage only, so recording never allocates
+// and the values outlive the threads that wrote them.
+struct ThreadSlot
+{
+    std::atomic<std::uint64_t> nanoseconds[NumTimers];
+    std::atomic<std::uint64_t> calls[NumTimers];
+    std::atomic<std::uint64_t> counters[NumCounters];
+};
+
+ThreadSlot slots[MaxThreads];
+std::atomic<int> usedSlots{ 0 };
+
+ThreadSlot& threadSlot()
+{
+    thread_local int slot = usedSlots.fetch_add(1, std::memory_order_relaxed);
+    return slots[slot % MaxThreads];
+}
+
+int numThreads()
+{
+    int used = usedSlots.load(std::memory_order_relaxed);
+    return used < MaxThreads ? used : MaxThreads;
+}
+
+const char* timerName(int timer)
+{
+    static const char* const names[NumTimers] = { "generate", "corners", "midside", "validity",
+                                                  "qualityTarget", "allocate", "format", "fileSystem" };
+    return names[timer];
+}
+
+const char* counterName(int counter)
+{
+    static const char* const names[NumCounters] = { "elements", "nodes", "bytesWritten", "filesOpened", "allocations" };
+    return names[counter];
+}
+
+std::uint64_t value(const std::atomic<std::uint64_t>& v)
+{
+    return v.load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+void recordTimer(InstrumentTimer timer, std::uint64_t nanoseconds)
+{
+    ThreadSlot& slot = threadSlot();
+    slot.nanoseconds[static_cast<int>(timer)].fetch_add(nanoseconds, std::memory_order_relaxed);
+    slot.calls[static_cast<int>(timer)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void recordCount(InstrumentCounter counter, std::uint64_t n)
+{
+    threadSlot().counters[static_cast<int>(counter)].fetch_add(n, std::memory_order_relaxed);
+}
+
+std::uint64_t instrumentationTotal(InstrumentCounter counter)
+{
+    std::uint64_t total = 0;
+    for (int t = 0; t < numThreads(); ++t)
+    {
+        total += value(slots[t].counters[static_cast<int>(counter)]);
+    }
+    return total;
+}
+
+void printInstrumentation(std::FILE* out)
+{
+    int threads = numThreads();
+    std::fprintf(out, "Instrumentation (%d threads)\n  %-14s %12s %10s", threads, "timer", "seconds", "calls");
+    for (int t = 0; t < threads; ++t)
+    {
+        char label[32];
+        std::snprintf(label, sizeof(label), "thread %d", t);
+        std::fprintf(out, " %12s", label);
+    }
+    std::fprintf(out, "\n");
+    for (int i = 0; i < NumTimers; ++i)
+    {
+        std::uint64_t ns = 0;
+        std::uint64_t calls = 0;
+        for (int t = 0; t < threads; ++t)
+        {
+            ns += value(slots[t].nanoseconds[i]);
+            calls += value(slots[t].calls[i]);
+        }
+        std::fprintf(out, "  %-14s %12.6f %10llu", timerName(i), 1e-9 * static_cast<double>(ns),
+                     static_cast<unsigned long long>(calls));
+        for (int t = 0; t < threads; ++t)
+        {
+            std::fprintf(out, " %12.6f", 1e-9 * static_cast<double>(value(slots[t].nanoseconds[i])));
+        }
+        std::fprintf(out, "\n");
+    }
+    std::fprintf(out, "  %-14s %12s %10s\n", "counter", "total", "");
+    for (int i = 0; i < NumCounters; ++i)
+    {
+        std::uint64_t total = 0;
+        for (int t = 0; t < threads; ++t)
+        {
+            total += value(slots[t].counters[i]);
+        }
+        std::fprintf(out, "  %-14s %12llu %10s", counterName(i), static_cast<unsigned long long>(total), "");
+        for (int t = 0; t < threads; ++t)
+        {
+            std::fprintf(out, " %12llu", static_cast<unsigned long long>(value(slots[t].counters[i])));
+        }
+        std::fprintf(out, "\n");
+    }
+}
+
+bool writeInstrumentationJson(const char* path)
+{
+    std::FILE* out = std::fopen(path, "w");
+    if (out == nullptr)
+    {
+        return false;
+    }
+    int threads = numThreads();
+    std::fprintf(out, "{\n  \"threads\": %d,\n  \"timers\": {\n", threads);
+    for (int i = 0; i < NumTimers; ++i)
+    {
+        std::uint64_t ns = 0;
+        std::uint64_t calls = 0;
+        for (int t = 0; t < threads; ++t)
+        {
+            ns += value(slots[t].nanoseconds[i]);
+            calls += value(slots[t].calls[i]);
+        }
+        std::fprintf(out, "    \"%s\": {\"seconds\": %.9g, \"calls\": %llu, \"perThreadSeconds\": [", timerName(i),
+                     1e-9 * static_cast<double>(ns), static_cast<unsigned long long>(calls));
+        for (int t = 0; t < threads; ++t)
+        {
+            std::fprintf(out, "%s%.9g", t > 0 ? ", " : "", 1e-9 * static_cast<double>(value(slots[t].nanoseconds[i])));
+        }
+        std::fprintf(out, "]}%s\n", i + 1 < NumTimers ? "," : "");
+    }
+    std::fprintf(out, "  },\n  \"counters\": {\n");
+    for (int i = 0; i < NumCounters; ++i)
+    {
+        std::uint64_t total = 0;
+        for (int t = 0; t < threads; ++t)
+        {
+            total += value(slots[t].counters[i]);
+        }
+        std::fprintf(out, "    \"%s\": {\"total\": %llu, \"perThread\": [", counterName(i), static_cast<unsigned long long>(total));
+        for (int t = 0; t < threads; ++t)
+        {
+            std::fprintf(out, "%s%llu", t > 0 ? ", " : "", static_cast<unsigned long long>(value(slots[t].counters[i])));
+        }
+        std::fprintf(out, "]}%s\n", i + 1 < NumCounters ? "," : "");
+    }
+    std::fprintf(out, "  }\n}\n");
+    return std::fclose(out) == 0;
+}
+
+#else
+
+void printInstrumentation(std::FILE*)
+{
+}
+
+bool writeInstrumentationJson(const char*)
+{
+    return false;
+}
+
+#endif
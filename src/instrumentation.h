@@ -0,0 +1,95 @@
+// Optional run instrumentation: scoped timers and event counters, kept per
+// thread and reported at the end of a run as a summary or as JSON. Build with
+// -DELEMENT_INSTRUMENTATION to enable it. Otherwise INSTRUMENT_TIMER and
+// INSTRUMENT_COUNT expand to nothing, so no instrumentation code or data is
+// compiled into the generator or the writers.
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <cstdint>
+#include <cstdio>
+
+// Timers are inclusive: Generate contains Corners, Midside, Validity and
+// QualityTarget of the same chunk; Format contains the FileSystem time of
+// the flushes it triggers.
+enum class InstrumentTimer
+{
+    Generate,       // generation of a chunk of elements
+    Corners,        // random corner nodes (RNG)
+    Midside,        // midside node insertion
+    Validity,       // validity filter candidates
+    QualityTarget,  // quality-targeted corners
+    Allocate,       // element batch allocation
+    Format,         // writer formatting / interleaving
+    FileSystem,     // fopen, fwrite, fclose
+    Count
+};
+
+enum class InstrumentCounter
+{
+    Elements,       // elements generated
+    Nodes,          // nodes generated
+    BytesWritten,   // bytes handed to the file system
+    FilesOpened,
+    Allocations,    // heap allocations (global operator new, see instrumentedAllocator.cpp)
+    Count
+};
+
+#ifdef ELEMENT_INSTRUMENTATION
+constexpr bool InstrumentationEnabled = true;
+#else
+constexpr bool InstrumentationEnabled = false;
+#endif
+
+// Totals and per-thread values of every timer and counter since the start of
+// the process; threads are numbered in the order they first record something.
+// Both do nothing without ELEMENT_INSTRUMENTATION.
+void printInstrumentation(std::FILE* out);
+bool writeInstrumentationJson(const char* path);
+
+#ifdef ELEMENT_INSTRUMENTATION
+
+#include <chrono>
+
+void recordTimer(InstrumentTimer timer, std::uint64_t nanoseconds);
+void recordCount(InstrumentCounter counter, std::uint64_t n);
+
+// Sum of a counter over all threads
+std::uint64_t instrumentationTotal(InstrumentCounter counter);
+
+// Adds the lifetime of the object to a timer of the calling thread
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(InstrumentTimer instrumentTimer)
+        : timer(instrumentTimer), start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        recordTimer(timer, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    InstrumentTimer timer;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+#define INSTRUMENT_TIMER(timer) ScopedTimer INSTRUMENT_CONCAT(instrumentTimer, __LINE__)(InstrumentTimer::timer)
+#define INSTRUMENT_COUNT(counter, n) recordCount(InstrumentCounter::counter, static_cast<std::uint64_t>(n))
+
+#else
+
+#define INSTRUMENT_TIMER(timer) ((void)0)
+#define INSTRUMENT_COUNT(counter, n) ((void)0)
+
+#endif
+
+#endif
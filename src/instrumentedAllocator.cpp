@@ -0,0 +1,26 @@
+// Replacement of the global operator new/delete that feeds the Allocations
+// counter. It is kept apart from instrumentation.cpp so the library does not
+// replace the allocator of the program it is linked into; link this file
+// only into executables (the generator does, through src/*.cpp).
+#include "instrumentation.h"
+
+#ifdef ELEMENT_INSTRUMENTATION
+
+#include <cstdlib>
+#include <new>
+
+// Every heap allocation of the process is counted on the allocating thread
+void* operator new(std::size_t size)
+{
+    recordCount(InstrumentCounter::Allocations, 1);
+    if (void* p = std::malloc(size > 0 ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+#endif
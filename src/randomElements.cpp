@@ -0,0 +1,29 @@
+#include "randomElements.h"
+
+std::size_t generatedSize(ElementType type, std::size_t count)
+{
+    return 3 * count * static_cast<std::size_t>(nodesPerElement(type));
+}
+
+bool generateInto(double* out, std::size_t outSize, ElementType type, std::uint64_t first, std::size_t count,
+                  const GenerationOptions& options, ThreadPool& pool)
+{
+    if (outSize < generatedSize(type, count) || (out == nullptr && count > 0)) {
+        return false;
+    }
+    ElementBatch view(type, out, count);
+    ElementBatch standard = getStandardElement(type, options.minCoord, options.maxCoord);
+    generateElementRange(view, first, standard, options, pool);
+    return true;
+}
+
+bool generateInto(double* out, std::size_t outSize, ElementType type, std::uint64_t first, std::size_t count,
+                  std::uint64_t seed, ElementBounds bounds, unsigned numThreads)
+{
+    GenerationOptions options;
+    options.minCoord = bounds.minCoord;
+    options.maxCoord = bounds.maxCoord;
+    options.seed = seed;
+    ThreadPool pool(numThreads > 0 ? numThreads : 1);
+    return generateInto(out, outSize, type, first, count, options, pool);
+}
@@ -0,0 +1,46 @@
+// Library interface of the generator. Link against the static library built
+// from elementGenerator.cpp, elementMesh.cpp, elementMetrics.cpp,
+// instrumentation.cpp and randomElements.cpp (see README) to generate,
+// measure and write elements and meshes in-process, without running the
+// command line tool.
+//
+// generateInto writes a range of a run straight into memory the caller owns
+// (a vector, an arena, a pooled buffer), in the planar ElementBatch layout:
+// all x, then all y, then all z, node j of element e at e * nodesPerElement + j.
+// The elements are the same as the tool produces for the same seed, type,
+// bounds and index.
+#ifndef RANDOM_ELEMENTS_H
+#define RANDOM_ELEMENTS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "elementBatch.h"
+#include "elementGenerator.h"
+#include "elementMesh.h"
+#include "elementMetrics.h"
+#include "elementTopology.h"
+#include "elementWriters.h"
+
+struct ElementBounds
+{
+    double minCoord = 0.0;
+    double maxCoord = 10.0;
+};
+
+// Doubles generateInto needs for count elements of type
+std::size_t generatedSize(ElementType type, std::size_t count);
+
+// Elements first .. first+count-1 of the run (seed, type, bounds) into
+// out[0 .. generatedSize(type, count)). numThreads > 1 runs a thread pool
+// for the call. false if outSize is too small; out is then left untouched.
+bool generateInto(double* out, std::size_t outSize, ElementType type, std::uint64_t first, std::size_t count,
+                  std::uint64_t seed, ElementBounds bounds = ElementBounds(), unsigned numThreads = 1);
+
+// Same with every GenerationOptions setting (validity filter, quality target)
+// and a pool the caller keeps between calls; the range arguments are in the
+// same order
+bool generateInto(double* out, std::size_t outSize, ElementType type, std::uint64_t first, std::size_t count,
+                  const GenerationOptions& options, ThreadPool& pool);
+
+#endif
@@ -0,0 +1,205 @@
+// Checks the invariants of connected meshes (--mesh) for every type that has
+// one: every node id from 1 to meshNodeCount written exactly once (no
+// duplicate or missing GRIDs) and used by some element (no unused GRIDs),
+// element coordinates equal to those of their node ids, one midside id per
+// grid edge shared by all elements on it, no inverted element, element
+// sizes adding up to the box, and the same mesh for 1 and 4 threads and for
+// different partition sizes. Exits with 1 if any check fails.
+//
+//   g++ -std=c++17 -O2 -pthread -Isrc tools/checkMesh.cpp src/elementGenerator.cpp
+//       src/elementMesh.cpp src/elementMetrics.cpp src/instrumentation.cpp -o checkMesh
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "elementGenerator.h"
+#include "elementMesh.h"
+#include "elementMetrics.h"
+#include "elementTopology.h"
+
+namespace
+{
+
+struct Run
+{
+    unsigned threads;
+    std::size_t partitionElements;
+};
+
+const Run Runs[] = { { 1, 200 }, { 4, 200 }, { 4, 1 } };
+
+std::uint64_t hashValue(std::uint64_t hash, std::uint64_t value)
+{
+    return (hash ^ value) * 1099511628211ull;
+}
+
+std::uint64_t hashValue(std::uint64_t hash, double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return hashValue(hash, bits);
+}
+
+// Midside node k of every element must have the id of the other elements on
+// the same edge (the pair of corner ids)
+template <typename Traits>
+int countSplitEdges(const std::vector<std::uint64_t>& connectivity)
+{
+    int split = 0;
+    if constexpr (Traits::Midside > 0)
+    {
+        std::map<std::pair<std::uint64_t, std::uint64_t>, std::uint64_t> midside;
+        for (std::size_t e = 0; e < connectivity.size() / Traits::Nodes; ++e)
+        {
+            const std::uint64_t* ids = &connectivity[e * Traits::Nodes];
+            for (int k = 0; k < Traits::Midside; ++k)
+            {
+                std::uint64_t a = ids[Traits::Edges[k][0]];
+                std::uint64_t b = ids[Traits::Edges[k][1]];
+                auto inserted = midside.emplace(std::make_pair(std::min(a, b), std::max(a, b)), ids[Traits::Corners + k]);
+                if (!inserted.second && inserted.first->second != ids[Traits::Corners + k])
+                {
+                    ++split;
+                }
+            }
+        }
+    }
+    return split;
+}
+
+// One mesh of type; false if a check fails. signature identifies the nodes
+// and the connectivity.
+bool checkRun(ElementType type, const MeshOptions& options, const Run& run, std::uint64_t& signature)
+{
+    std::uint64_t numNodes = meshNodeCount(type, options);
+    std::uint64_t numElements = meshElementCount(type, options);
+    std::vector<int> written(numNodes + 1, 0);
+    std::vector<int> used(numNodes + 1, 0);
+    std::vector<double> x(numNodes + 1), y(numNodes + 1), z(numNodes + 1);
+    std::vector<std::uint64_t> connectivity;
+    std::vector<double> elementXyz;
+    std::uint64_t nextElement = 0;
+    bool ordered = true;
+    double minJacobian = 1.0;
+    double size = 0.0;
+
+    ThreadPool pool(run.threads);
+    bool ok = streamMesh(type, options, pool, run.partitionElements, 2, [&](const MeshPartition& partition) {
+        for (std::size_t i = 0; i < partition.nodeIds.size(); ++i)
+        {
+            std::uint64_t id = partition.nodeIds[i];
+            if (id < 1 || id > numNodes)
+            {
+                return false;
+            }
+            ++written[id];
+            x[id] = partition.nodeX[i];
+            y[id] = partition.nodeY[i];
+            z[id] = partition.nodeZ[i];
+        }
+        ordered = ordered && partition.firstElement == nextElement;
+        nextElement += partition.elements.size();
+        connectivity.insert(connectivity.end(), partition.connectivity.begin(), partition.connectivity.end());
+        for (std::size_t e = 0; e < partition.elements.size(); ++e)
+        {
+            for (int j = 0; j < partition.elements.nodesPerElement; ++j)
+            {
+                elementXyz.push_back(partition.elements.x(e, j));
+                elementXyz.push_back(partition.elements.y(e, j));
+                elementXyz.push_back(partition.elements.z(e, j));
+            }
+        }
+        QualityMetrics quality;
+        computeQuality(partition.elements, quality);
+        for (std::size_t e = 0; e < partition.elements.size(); ++e)
+        {
+            minJacobian = std::min(minJacobian, quality.scaledJacobian[e]);
+            size += quality.size[e];
+        }
+        return true;
+    });
+
+    int missing = 0;
+    int duplicate = 0;
+    int unused = 0;
+    int mismatched = 0;
+    for (std::size_t i = 0; i < connectivity.size(); ++i)
+    {
+        std::uint64_t id = connectivity[i];
+        if (id < 1 || id > numNodes || x[id] != elementXyz[3 * i] || y[id] != elementXyz[3 * i + 1] ||
+            z[id] != elementXyz[3 * i + 2])
+        {
+            ++mismatched;
+            continue;
+        }
+        ++used[id];
+    }
+    signature = 1469598103934665603ull;
+    for (std::uint64_t id = 1; id <= numNodes; ++id)
+    {
+        missing += written[id] == 0;
+        duplicate += written[id] > 1;
+        unused += used[id] == 0;
+        signature = hashValue(hashValue(hashValue(signature, x[id]), y[id]), z[id]);
+    }
+    for (std::uint64_t id : connectivity)
+    {
+        signature = hashValue(signature, id);
+    }
+    int split = withElementTraits(type, [&](auto traits) { return countSplitEdges<decltype(traits)>(connectivity); });
+    int dim = withElementTraits(type, [](auto traits) { return decltype(traits)::Dim; });
+    double box = std::pow(options.maxCoord - options.minCoord, dim);
+    bool filled = std::fabs(size - box) <= 1e-9 * box;
+
+    bool passed = ok && ordered && nextElement == numElements && missing == 0 && duplicate == 0 && unused == 0 &&
+                  mismatched == 0 && split == 0 && minJacobian > 0.0 && filled;
+    std::printf("%-18s %u threads, partitions of %5zu: %s (elements %llu/%llu, missing %d, duplicate %d, unused %d, "
+                "mismatched %d, split edges %d, min scaled Jacobian %.3f, size %.9g of %.9g)\n",
+                elementTypeName(type), run.threads, run.partitionElements, passed ? "ok" : "FAILED",
+                static_cast<unsigned long long>(nextElement), static_cast<unsigned long long>(numElements), missing,
+                duplicate, unused, mismatched, split, minJacobian, size, box);
+    return passed;
+}
+
+} // namespace
+
+int main()
+{
+    MeshOptions options;
+    options.cells[0] = 7;
+    options.cells[1] = 5;
+    options.cells[2] = 6;
+    options.seed = 99;
+
+    bool passed = true;
+    for (int t = 0; t < NumElementTypes; ++t)
+    {
+        ElementType type = static_cast<ElementType>(t);
+        if (!meshSupported(type))
+        {
+            continue;
+        }
+        std::uint64_t first = 0;
+        for (std::size_t r = 0; r < sizeof(Runs) / sizeof(Runs[0]); ++r)
+        {
+            std::uint64_t signature = 0;
+            passed = checkRun(type, options, Runs[r], signature) && passed;
+            if (r == 0)
+            {
+                first = signature;
+            }
+            else if (signature != first)
+            {
+                std::printf("%-18s differs from the single-threaded mesh\n", elementTypeName(type));
+                passed = false;
+            }
+        }
+    }
+    std::printf("%s\n", passed ? "all mesh checks passed" : "mesh checks FAILED");
+    return passed ? 0 : 1;
+}
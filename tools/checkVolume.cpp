@@ -0,0 +1,94 @@
+// Checks the element size of computeQuality against the analytic volume of
+// warped trilinear hexas: random corners around a unit cube, the exact
+// volume being the integral of det J, which 2x2x2 Gauss points integrate
+// exactly. Prints the worst relative error and exits with 1 above 1e-12.
+//
+//   g++ -std=c++17 -O2 -pthread -Isrc tools/checkVolume.cpp src/elementGenerator.cpp
+//       src/elementMetrics.cpp src/instrumentation.cpp -o checkVolume
+#include <cmath>
+#include <cstdio>
+
+#include "elementBatch.h"
+#include "elementGenerator.h"
+#include "elementMetrics.h"
+
+namespace
+{
+
+const std::size_t NumElements = 10000;
+const double Warp = 0.3;
+
+// Corner k of the reference hexa at (+-1, +-1, +-1), in the corner order of
+// getIdealElement
+void referenceCorner(int k, double r[3])
+{
+    r[0] = (k % 4 == 1 || k % 4 == 2) ? 1.0 : -1.0;
+    r[1] = k % 4 >= 2 ? 1.0 : -1.0;
+    r[2] = k >= 4 ? 1.0 : -1.0;
+}
+
+double trilinearVolume(const ElementBatch& batch, std::size_t elm)
+{
+    const double g = 1.0 / std::sqrt(3.0);
+    double volume = 0.0;
+    for (int p = 0; p < 8; ++p)
+    {
+        double xi[3] = { p & 1 ? g : -g, p & 2 ? g : -g, p & 4 ? g : -g };
+        double jac[3][3] = {};
+        for (int k = 0; k < 8; ++k)
+        {
+            double r[3];
+            referenceCorner(k, r);
+            double dn[3] = { r[0] * (1 + r[1] * xi[1]) * (1 + r[2] * xi[2]) / 8.0,
+                             r[1] * (1 + r[0] * xi[0]) * (1 + r[2] * xi[2]) / 8.0,
+                             r[2] * (1 + r[0] * xi[0]) * (1 + r[1] * xi[1]) / 8.0 };
+            double node[3] = { batch.x(elm, k), batch.y(elm, k), batch.z(elm, k) };
+            for (int a = 0; a < 3; ++a)
+            {
+                for (int b = 0; b < 3; ++b)
+                {
+                    jac[a][b] += node[a] * dn[b];
+                }
+            }
+        }
+        volume += jac[0][0] * (jac[1][1] * jac[2][2] - jac[1][2] * jac[2][1]) -
+                  jac[0][1] * (jac[1][0] * jac[2][2] - jac[1][2] * jac[2][0]) +
+                  jac[0][2] * (jac[1][0] * jac[2][1] - jac[1][1] * jac[2][0]);
+    }
+    return volume;
+}
+
+} // namespace
+
+int main()
+{
+    ElementBatch batch(ElementType::LINEAR_HEXA, NumElements);
+    for (std::size_t e = 0; e < NumElements; ++e)
+    {
+        PhiloxRng rng(1, e);
+        for (int k = 0; k < 8; ++k)
+        {
+            double r[3];
+            referenceCorner(k, r);
+            batch.setNode(e, k, 0.5 * r[0] + rng.uniform(-Warp, Warp), 0.5 * r[1] + rng.uniform(-Warp, Warp),
+                          0.5 * r[2] + rng.uniform(-Warp, Warp));
+        }
+    }
+    QualityMetrics quality;
+    computeQuality(batch, quality);
+
+    double worst = 0.0;
+    std::size_t worstElement = 0;
+    for (std::size_t e = 0; e < NumElements; ++e)
+    {
+        double exact = trilinearVolume(batch, e);
+        double error = std::fabs(quality.size[e] - exact) / std::fabs(exact);
+        if (error > worst)
+        {
+            worst = error;
+            worstElement = e;
+        }
+    }
+    std::printf("warped hexas: worst relative volume error %.3g (element %zu)\n", worst, worstElement);
+    return worst > 1e-12 ? 1 : 0;
+}